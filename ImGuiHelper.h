@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <string>
+#include <vector>
 #include "imgui/imgui.h"
 #include "imgui/imgui_internal.h"
 
@@ -98,5 +100,124 @@ inline bool ScrollCombo(int* index, size_t size)
     return false;
 }
 //---------------------------------------------------------------------------
+inline int FindLine(const std::string& text, const std::vector<uint32_t>& lines, const std::string& search, int start, int step)
+{
+    int count = (int)lines.size();
+    if (search.empty() || count == 0)
+        return -1;
+    for (int n = 0; n < count; ++n) {
+        int line = ((start + n * step) % count + count) % count;
+        auto begin = text.begin() + lines[line];
+        auto end = (line + 1 < count) ? text.begin() + lines[line + 1] : text.end();
+        auto it = std::search(begin, end, search.begin(), search.end(), [](char a, char b) {
+            return tolower((unsigned char)a) == tolower((unsigned char)b);
+        });
+        if (it != end)
+            return line;
+    }
+    return -1;
+}
+//---------------------------------------------------------------------------
+inline void TextView(const char* label, const std::string& text, const std::vector<uint32_t>& lines, int* current_line, std::string& search, const ImVec2& size = ImVec2(0, 0))
+{
+    PushID(label);
+
+    // Only the view in the focused window takes F3 and Ctrl+C
+    bool focused = IsWindowFocused(ImGuiFocusedFlags_ChildWindows);
+
+    // Incremental search : typing searches from the current line, Enter / F3 moves to the next match
+    int found = -1;
+    SetNextItemWidth(size.x > 0.0f ? size.x : GetContentRegionAvail().x);
+    bool enter = InputTextEx("##search", "Search", search, ImVec2(0, 0), ImGuiInputTextFlags_EnterReturnsTrue);
+    bool edited = IsItemEdited();
+    bool typing = IsItemActive();
+    bool shift = GetIO().KeyShift;
+    if (enter) {
+        SetKeyboardFocusHere(-1);
+    }
+    if (edited) {
+        found = FindLine(text, lines, search, *current_line, 1);
+    }
+    else if (enter || (focused && IsKeyPressed(ImGuiKey_F3))) {
+        found = FindLine(text, lines, search, *current_line + (shift ? -1 : 1), shift ? -1 : 1);
+    }
+    if (found >= 0) {
+        *current_line = found;
+    }
+
+    ImVec2 region = GetContentRegionAvail();
+    if (size.x > 0.0f) region.x = size.x;
+    if (size.y > 0.0f) region.y = size.y - GetFrameHeightWithSpacing();
+    if (BeginChild("##text", region, ImGuiChildFlags_FrameStyle, ImGuiWindowFlags_HorizontalScrollbar)) {
+        int count = (int)lines.size();
+        float height = GetTextLineHeightWithSpacing();
+
+        // Selection : a click picks a line, Shift+click extends the range from
+        // the anchor, Ctrl+C or the context menu copies the lines
+        int& anchor = GetStateStorage()->GetIntRef(GetID("##anchor"), -1);
+        if (anchor >= count || found >= 0)
+            anchor = -1;
+        ImVec2 origin = GetCursorScreenPos();
+        if (IsWindowHovered() && IsMouseClicked(ImGuiMouseButton_Left)) {
+            int line = int((GetMousePos().y - origin.y) / height);
+            if (line >= 0 && line < count) {
+                if (shift == false || anchor < 0)
+                    anchor = line;
+                *current_line = line;
+            }
+        }
+        int first = std::min(anchor, *current_line);
+        int last = std::max(anchor, *current_line);
+        auto copy = [&](int from, int to) {
+            size_t begin = lines[from];
+            size_t end = (to + 1 < count) ? lines[to + 1] : text.size();
+            SetClipboardText(text.substr(begin, end - begin).c_str());
+        };
+        if (focused && typing == false && anchor >= 0 && GetIO().KeyCtrl && IsKeyPressed(ImGuiKey_C)) {
+            copy(first, last);
+        }
+        if (BeginPopupContextWindow()) {
+            if (MenuItem("Copy", "Ctrl+C", false, anchor >= 0))
+                copy(first, last);
+            if (MenuItem("Copy All", nullptr, false, count > 0))
+                copy(0, count - 1);
+            EndPopup();
+        }
+
+        ImGuiListClipper clipper;
+        clipper.Begin(count, height);
+        if (found >= 0) {
+            clipper.IncludeItemByIndex(found);
+        }
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                const char* begin = text.data() + lines[i];
+                const char* end = (i + 1 < count) ? text.data() + lines[i + 1] : text.data() + text.size();
+                if (end > begin && end[-1] == '\n')
+                    end--;
+                if (anchor >= 0 && i >= first && i <= last) {
+                    ImVec2 position = GetCursorScreenPos();
+                    ImVec2 corner(position.x + GetContentRegionAvail().x, position.y + height);
+                    GetWindowDrawList()->AddRectFilled(position, corner, GetColorU32(ImGuiCol_Header));
+                }
+                if (i == (*current_line) && search.empty() == false) {
+                    PushStyleColor(ImGuiCol_Text, GetStyleColorVec4(ImGuiCol_PlotLinesHovered));
+                    TextUnformatted(begin, end);
+                    PopStyleColor();
+                }
+                else {
+                    TextUnformatted(begin, end);
+                }
+                if (i == found) {
+                    SetScrollHereY();
+                }
+            }
+        }
+    }
+    EndChild();
+
+    PopID();
+}
+//---------------------------------------------------------------------------
 } // namespace ImGui
 //---------------------------------------------------------------------------
@@ -1,8 +1,113 @@
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <thread>
 #include "Logger.h"
 
-std::vector<std::string> logs[2];
+namespace {
+
+// One conversion of a printf format
+struct Specifier {
+    const char* modifier;
+    char conversion;
+    int stars;
+    bool precision_star;
+    int precision;
+};
+
+const char* Scan(const char* format, Specifier& spec)
+{
+    spec = { nullptr, 0, 0, false, -1 };
+    const char* c = format + 1;
+    while (*c && strchr("-+ #0'", *c))
+        c++;
+    if (*c == '*') {
+        spec.stars++;
+        c++;
+    }
+    while (*c >= '0' && *c <= '9')
+        c++;
+    if (*c == '.') {
+        c++;
+        spec.precision = 0;
+        if (*c == '*') {
+            spec.stars++;
+            spec.precision_star = true;
+            c++;
+        }
+        while (*c >= '0' && *c <= '9')
+            spec.precision = spec.precision * 10 + (*c++ - '0');
+    }
+    spec.modifier = c;
+    while (*c && strchr("hlLqjzt", *c))
+        c++;
+    spec.conversion = *c;
+    return *c ? c + 1 : c;
+}
+
+template<typename T>
+void Print(std::string& text, const char* spec, int stars, const int* star, T value)
+{
+    char temp[256];
+    char* output = temp;
+    std::string large;
+    for (int pass = 0; pass < 2; ++pass) {
+        size_t size = pass ? large.size() : sizeof(temp);
+        int length = 0;
+        switch (stars) {
+        case 0: length = snprintf(output, size, spec, value); break;
+        case 1: length = snprintf(output, size, spec, star[0], value); break;
+        default: length = snprintf(output, size, spec, star[0], star[1], value); break;
+        }
+        if (length < 0)
+            return;
+        if (size_t(length) < size) {
+            text.append(output, length);
+            return;
+        }
+        large.resize(length + 1);
+        output = large.data();
+    }
+}
+
+// Queues of every thread which logged, the thread running static initialization draws the logs
+std::mutex queue_mutex;
+std::vector<std::shared_ptr<LogQueue>> queues;
+const std::thread::id consumer = std::this_thread::get_id();
+std::atomic<uint32_t> job_serial;
+size_t lost;
+
+struct Producer {
+    std::shared_ptr<LogQueue> queue;
+    ~Producer() {
+        if (queue) {
+            queue->retired = true;
+        }
+    }
+};
+
+};  // namespace
+
+LogBuffer logs[2];
 int logs_index[2];
 int logs_focus[2];
+thread_local uint32_t logs_job;
+uint32_t trace_mask = TRACE_ALL;
+const char* trace_names[TRACE_COUNT] = {
+    "Call",
+    "Import",
+    "Heap",
+    "File",
+    "Exception",
+    "VM",
+    "D3D",
+    "AMD",
+    "ATI",
+    "Mali",
+    "NV",
+    "QCOM",
+};
 const char* eascii[0x80] = {
     "\xC3\x87",
     "\xC3\xBC",
@@ -133,3 +238,445 @@ const char* eascii[0x80] = {
     "\xE2\x96\xA0",
     "\xE2\x8C\x82",
 };
+
+const char* LogBuffer::Line(size_t index) const
+{
+    if (index >= count)
+        return "";
+    return Text(index);
+}
+
+uint32_t LogBuffer::Job(size_t index) const
+{
+    if (index >= count)
+        return 0;
+    return records[(first + index) % LINE_CAPACITY].job;
+}
+
+void LogBuffer::Append(const char* text, size_t length, uint32_t job)
+{
+    if (count == 0 || Back().deferred)
+        Break(job);
+
+    // An empty line belongs to whoever writes into it first
+    if (Back().length == 0)
+        Back().job = job;
+
+    const char* end = text + length;
+    while (text < end) {
+        const char* span = text;
+        while (span < end && (*span) != '\t' && (*span) != '\n')
+            span++;
+        Extend(text, span - text);
+        if (span == end)
+            break;
+        if ((*span) == '\t') {
+            Extend(nullptr, 8 - Back().length % 8, ' ');
+        }
+        else {
+            Break(job);
+        }
+        text = span + 1;
+    }
+}
+
+void LogBuffer::Break(uint32_t job)
+{
+    if (arena == nullptr) {
+        records.reset(new Record[LINE_CAPACITY]);
+        arena.reset(new char[BYTE_CAPACITY]);
+    }
+    if (count == LINE_CAPACITY)
+        Evict();
+
+    uint32_t offset = 0;
+    if (count) {
+        offset = Back().offset + Back().length + 1;
+    }
+    count++;
+    Back() = { offset, 0, 0, job };
+    Grow(0);
+    arena[Back().offset] = 0;
+}
+
+void LogBuffer::Clear()
+{
+    first = 0;
+    count = 0;
+    dropped = 0;
+    std::fill(std::begin(cache_index), std::end(cache_index), 0);
+}
+
+void LogBuffer::Copy(std::vector<std::string>& lines, size_t from) const
+{
+    for (size_t i = std::max(from, dropped); i < dropped + count; ++i) {
+        lines.emplace_back(Text(i - dropped));
+    }
+}
+
+void LogBuffer::Extend(const char* text, size_t length, char fill)
+{
+    length = Grow(length);
+    auto& line = Back();
+    char* output = arena.get() + line.offset + line.length;
+    if (text) {
+        memcpy(output, text, length);
+    }
+    else {
+        memset(output, fill, length);
+    }
+    output[length] = 0;
+    line.length += uint32_t(length);
+}
+
+size_t LogBuffer::Grow(size_t length)
+{
+    auto& line = Back();
+    length = std::min(length, BYTE_CAPACITY - 1 - line.length);
+    size_t end = line.offset + line.length + length + 1;
+    if (end <= BYTE_CAPACITY) {
+        while (count > 1 && Front().offset >= line.offset && Front().offset < end)
+            Evict();
+        return length;
+    }
+
+    // Wrap around, whatever is left past this line is older than the lines at the start
+    while (count > 1 && Front().offset >= line.offset)
+        Evict();
+    end = line.length + length + 1;
+    while (count > 1 && Front().offset < end)
+        Evict();
+    memmove(arena.get(), arena.get() + line.offset, line.length);
+    line.offset = 0;
+    return length;
+}
+
+void LogBuffer::Evict()
+{
+    first = (first + 1) % LINE_CAPACITY;
+    count--;
+    dropped++;
+}
+
+void LogBuffer::Defer(const char* format, va_list va, uint32_t job)
+{
+    char payload[PAYLOAD_SIZE];
+    size_t size = Pack(format, va, payload, sizeof(payload));
+    Insert(payload, size, job);
+}
+
+void LogBuffer::Insert(const char* payload, size_t size, uint32_t job)
+{
+    Break(job);
+    Extend(payload, size);
+    Back().deferred = 1;
+}
+
+size_t LogBuffer::Pack(const char* format, va_list va, char* payload, size_t capacity)
+{
+    // Only the arguments are copied here, strings included since they rarely outlive the call
+    size_t size = 0;
+    auto put = [&](const void* data, size_t length) {
+        length = std::min(length, capacity - size);
+        memcpy(payload + size, data, length);
+        size += length;
+    };
+    put(&format, sizeof(format));
+    for (const char* c = format; *c; ) {
+        if (*c++ != '%')
+            continue;
+        Specifier spec;
+        c = Scan(c - 1, spec);
+        int star[2] = {};
+        for (int i = 0; i < spec.stars; ++i) {
+            star[i] = va_arg(va, int);
+            put(&star[i], sizeof(int));
+        }
+        if (spec.precision_star)
+            spec.precision = star[spec.stars - 1];
+        bool wide = (*spec.modifier == 'l' || *spec.modifier == 'q' || *spec.modifier == 'j' || *spec.modifier == 'z' || *spec.modifier == 't');
+        switch (spec.conversion) {
+        case 'd': case 'i': case 'c': {
+            long long value = wide ? va_arg(va, long long) : va_arg(va, int);
+            put(&value, sizeof(value));
+            break;
+        }
+        case 'u': case 'o': case 'x': case 'X': {
+            unsigned long long value = wide ? va_arg(va, unsigned long long) : va_arg(va, unsigned int);
+            put(&value, sizeof(value));
+            break;
+        }
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+            long double value = (*spec.modifier == 'L') ? va_arg(va, long double) : va_arg(va, double);
+            put(&value, sizeof(value));
+            break;
+        }
+        case 's': {
+            const char* value = va_arg(va, const char*);
+            if (value == nullptr)
+                value = "(null)";
+            uint32_t length = uint32_t(spec.precision < 0 ? strlen(value) : strnlen(value, spec.precision));
+            length = uint32_t(std::min<size_t>(length, capacity - std::min(capacity, size + sizeof(length))));
+            put(&length, sizeof(length));
+            put(value, length);
+            break;
+        }
+        case 'p': case 'n': {
+            void* value = va_arg(va, void*);
+            put(&value, sizeof(value));
+            break;
+        }
+        }
+    }
+    return size;
+}
+
+const char* LogBuffer::Text(size_t index) const
+{
+    auto& record = records[(first + index) % LINE_CAPACITY];
+    const char* payload = arena.get() + record.offset;
+    if (record.deferred == 0)
+        return payload;
+
+    // Formatted lines are kept for the rows on screen, keyed by their absolute number
+    size_t absolute = dropped + index + 1;
+    auto& text = cache[absolute % CACHE_SIZE];
+    if (cache_index[absolute % CACHE_SIZE] == absolute)
+        return text.c_str();
+    cache_index[absolute % CACHE_SIZE] = absolute;
+    text.clear();
+
+    size_t size = record.length;
+    size_t cursor = 0;
+    auto get = [&](void* data, size_t length) {
+        memset(data, 0, length);
+        length = std::min(length, size - cursor);
+        memcpy(data, payload + cursor, length);
+        cursor += length;
+    };
+    const char* format = nullptr;
+    get(&format, sizeof(format));
+    for (const char* c = format; c && *c; ) {
+        const char* literal = c;
+        while (*c && *c != '%')
+            c++;
+        text.append(literal, c - literal);
+        if (*c == 0)
+            break;
+        Specifier spec;
+        const char* begin = c;
+        c = Scan(begin, spec);
+        if (spec.conversion == '%') {
+            text += '%';
+            continue;
+        }
+        int star[2] = {};
+        for (int i = 0; i < spec.stars; ++i) {
+            get(&star[i], sizeof(int));
+        }
+
+        // Length modifiers are rewritten to match the width the argument was stored with
+        std::string temp(begin, spec.modifier);
+        switch (spec.conversion) {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': {
+            long long value = 0;
+            get(&value, sizeof(value));
+            Print(text, (temp + "ll" + spec.conversion).c_str(), spec.stars, star, value);
+            break;
+        }
+        case 'c': {
+            long long value = 0;
+            get(&value, sizeof(value));
+            Print(text, (temp + spec.conversion).c_str(), spec.stars, star, int(value));
+            break;
+        }
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+            long double value = 0;
+            get(&value, sizeof(value));
+            Print(text, (temp + 'L' + spec.conversion).c_str(), spec.stars, star, value);
+            break;
+        }
+        case 's': {
+            uint32_t length = 0;
+            get(&length, sizeof(length));
+            length = uint32_t(std::min<size_t>(length, size - cursor));
+            std::string value(payload + cursor, length);
+            cursor += length;
+            Print(text, (temp + 's').c_str(), spec.stars, star, value.c_str());
+            break;
+        }
+        case 'p': {
+            void* value = nullptr;
+            get(&value, sizeof(value));
+            Print(text, (temp + 'p').c_str(), spec.stars, star, value);
+            break;
+        }
+        case 'n': {
+            void* value = nullptr;
+            get(&value, sizeof(value));
+            break;
+        }
+        }
+    }
+
+    // A deferred line is one row, tabs are expanded and line breaks folded
+    while (text.empty() == false && text.back() == '\n')
+        text.pop_back();
+    for (size_t i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '\n') {
+            text[i] = ' ';
+        }
+        else if (c == '\t') {
+            size_t tab = 8 - i % 8;
+            text.replace(i, 1, tab, ' ');
+            i += tab - 1;
+        }
+    }
+    return text.c_str();
+}
+
+uint32_t TraceCategory(const char* format)
+{
+    static const struct {
+        const char* keyword;
+        uint32_t category;
+    } keywords[] = {
+        { "[CALL]",       TRACE_CALL      },
+        { "Exception",    TRACE_EXCEPTION },
+        { "Symbol",       TRACE_IMPORT    },
+        { "Import",       TRACE_IMPORT    },
+        { "Library",      TRACE_IMPORT    },
+        { "Module",       TRACE_IMPORT    },
+        { "ProcAddress",  TRACE_IMPORT    },
+        { "Heap",         TRACE_HEAP      },
+        { "Alloc",        TRACE_HEAP      },
+        { "Free",         TRACE_HEAP      },
+        { "File",         TRACE_FILE      },
+    };
+
+    // Formats are literals, so the answer is remembered by address
+    static struct {
+        const char* format;
+        uint32_t category;
+    } cache[256];
+    auto& entry = cache[(uintptr_t(format) >> 3) % std::size(cache)];
+    if (entry.format == format)
+        return entry.category;
+
+    uint32_t category = TRACE_VM;
+    for (auto& keyword : keywords) {
+        if (strstr(format, keyword.keyword)) {
+            category = keyword.category;
+            break;
+        }
+    }
+    entry = { format, category };
+    return category;
+}
+
+void LogQueue::Read(size_t position, void* data, size_t size) const
+{
+    size_t offset = position % CAPACITY;
+    size_t first = std::min(size, CAPACITY - offset);
+    memcpy(data, this->data.get() + offset, first);
+    memcpy((char*)data + first, this->data.get(), size - first);
+}
+
+void LogQueue::Write(size_t position, const void* data, size_t size)
+{
+    size_t offset = position % CAPACITY;
+    size_t first = std::min(size, CAPACITY - offset);
+    memcpy(this->data.get() + offset, data, first);
+    memcpy(this->data.get(), (const char*)data + first, size - first);
+}
+
+bool LogQueue::Push(uint8_t index, uint8_t kind, uint32_t job, const char* payload, size_t size)
+{
+    size_t head = this->head.load(std::memory_order_relaxed);
+    size_t tail = this->tail.load(std::memory_order_acquire);
+    size = std::min(size, CAPACITY / 4);
+    if (CAPACITY - (head - tail) < sizeof(Header) + size) {
+        lost.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    Header header = { uint32_t(size), job, index, kind };
+    Write(head, &header, sizeof(header));
+    Write(head + sizeof(header), payload, size);
+    this->head.store(head + sizeof(header) + size, std::memory_order_release);
+    return true;
+}
+
+void LogQueue::Drain()
+{
+    size_t tail = this->tail.load(std::memory_order_relaxed);
+    size_t head = this->head.load(std::memory_order_acquire);
+    std::string payload;
+    while (tail != head) {
+        Header header;
+        Read(tail, &header, sizeof(header));
+        payload.resize(header.size);
+        Read(tail + sizeof(header), payload.data(), header.size);
+        tail += sizeof(header) + header.size;
+
+        auto& log = logs[header.index & 1];
+        switch (header.kind) {
+        case TEXT:
+            if (header.index == SYSTEM) {
+                log.Break(header.job);
+            }
+            log.Append(payload.data(), payload.size(), header.job);
+            break;
+        case DEFERRED:
+            log.Insert(payload.data(), payload.size(), header.job);
+            break;
+        }
+        logs_focus[header.index & 1] = (int)log.Size() - 1;
+    }
+    this->tail.store(tail, std::memory_order_release);
+}
+
+LogQueue* LoggerQueue()
+{
+    thread_local bool drawing = (std::this_thread::get_id() == consumer);
+    thread_local Producer producer;
+    if (drawing)
+        return nullptr;
+    if (producer.queue == nullptr) {
+        producer.queue = std::make_shared<LogQueue>();
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        queues.push_back(producer.queue);
+    }
+    return producer.queue.get();
+}
+
+void LoggerDrain()
+{
+    std::vector<std::shared_ptr<LogQueue>> drain;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        drain = queues;
+    }
+    for (auto& queue : drain) {
+        bool retired = queue->retired;
+        queue->Drain();
+        lost += queue->lost.exchange(0, std::memory_order_relaxed);
+
+        // A retired queue has seen its last push before the flag was raised
+        if (retired) {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            queues.erase(std::find(queues.begin(), queues.end(), queue));
+        }
+    }
+}
+
+uint32_t LoggerJob()
+{
+    logs_job = ++job_serial;
+    return logs_job;
+}
+
+size_t LoggerLost()
+{
+    return lost;
+}
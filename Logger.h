@@ -1,81 +1,161 @@
 #pragma once
 
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 
 #define CONSOLE 0
 #define SYSTEM  1
 
-extern std::vector<std::string> logs[2];
+// Trace categories, one bit each
+enum : uint32_t {
+    TRACE_CALL      = 1 << 0,
+    TRACE_IMPORT    = 1 << 1,
+    TRACE_HEAP      = 1 << 2,
+    TRACE_FILE      = 1 << 3,
+    TRACE_EXCEPTION = 1 << 4,
+    TRACE_VM        = 1 << 5,
+    TRACE_D3D       = 1 << 6,
+    TRACE_AMD       = 1 << 7,
+    TRACE_ATI       = 1 << 8,
+    TRACE_MALI      = 1 << 9,
+    TRACE_NV        = 1 << 10,
+    TRACE_QCOM      = 1 << 11,
+    TRACE_COUNT     = 12,
+    TRACE_ALL       = (1 << TRACE_COUNT) - 1,
+};
+
+// Categories compiled in, a release build can pass -DTRACE_CATEGORIES=0
+#ifndef TRACE_CATEGORIES
+#define TRACE_CATEGORIES TRACE_ALL
+#endif
+
+// Log with a fixed memory footprint
+//
+// Lines live back to back in one byte arena and are indexed by a ring of
+// records, once either is full the oldest lines are dropped and counted so a
+// long debug session holds steady instead of growing without bound.
+//
+// Deferred lines keep the format pointer and the raw arguments instead of the
+// text and are only formatted when somebody reads them, the format string has
+// to outlive the log which holds for the literals used by the tracing hooks.
+//
+// Every line carries the id of the job which wrote it.
+struct LogBuffer {
+    static constexpr size_t LINE_CAPACITY = 1 << 18;
+    static constexpr size_t BYTE_CAPACITY = 1 << 24;
+    static constexpr size_t PAYLOAD_SIZE = 1024;
+
+    const char* Line(size_t index) const;
+    uint32_t Job(size_t index) const;
+    size_t Size() const { return count; }
+    size_t Dropped() const { return dropped; }
+    size_t Total() const { return dropped + count; }
+    void Append(const char* text, size_t length, uint32_t job = 0);
+    void Defer(const char* format, va_list va, uint32_t job = 0);
+    void Insert(const char* payload, size_t size, uint32_t job = 0);
+    void Break(uint32_t job = 0);
+    void Clear();
+    void Copy(std::vector<std::string>& lines, size_t from) const;
+    static size_t Pack(const char* format, va_list va, char* payload, size_t capacity);
+
+private:
+    struct Record {
+        uint32_t offset;
+        uint32_t length : 31;
+        uint32_t deferred : 1;
+        uint32_t job;
+    };
+    static constexpr size_t CACHE_SIZE = 64;
+    Record& Front() { return records[first]; }
+    Record& Back() { return records[(first + count - 1) % LINE_CAPACITY]; }
+    void Extend(const char* text, size_t length, char fill = 0);
+    size_t Grow(size_t length);
+    void Evict();
+    const char* Text(size_t index) const;
+
+    std::unique_ptr<Record[]> records;
+    std::unique_ptr<char[]> arena;
+    size_t first = 0;
+    size_t count = 0;
+    size_t dropped = 0;
+    mutable std::string cache[CACHE_SIZE];
+    mutable size_t cache_index[CACHE_SIZE] = {};
+};
+
+// Records of one thread on their way to the logs
+//
+// Threads other than the one drawing the logs never touch them, each has a
+// single producer queue which LoggerDrain empties into the logs once a frame.
+// A full queue loses the record and counts it rather than block the VM.
+struct LogQueue {
+    static constexpr size_t CAPACITY = 1 << 20;
+    enum : uint8_t { TEXT, DEFERRED };
+
+    bool Push(uint8_t index, uint8_t kind, uint32_t job, const char* payload, size_t size);
+    void Drain();
+
+    std::atomic<bool> retired = false;
+    std::atomic<size_t> lost = 0;
+
+private:
+    struct Header {
+        uint32_t size;
+        uint32_t job;
+        uint8_t index;
+        uint8_t kind;
+    };
+    void Read(size_t position, void* data, size_t size) const;
+    void Write(size_t position, const void* data, size_t size);
+
+    std::unique_ptr<char[]> data = std::make_unique<char[]>(CAPACITY);
+    std::atomic<size_t> head = 0;
+    std::atomic<size_t> tail = 0;
+};
+
+extern LogBuffer logs[2];
 extern int logs_index[2];
 extern int logs_focus[2];
+extern thread_local uint32_t logs_job;
 extern const char* eascii[0x80];
+extern uint32_t trace_mask;
+extern const char* trace_names[TRACE_COUNT];
+
+uint32_t TraceCategory(const char* format);
+LogQueue* LoggerQueue();
+void LoggerDrain();
+uint32_t LoggerJob();
+size_t LoggerLost();
 
 template<int INDEX>
 static int LoggerV(const char* format, va_list va)
 {
     int index = INDEX;
-    int length = vsnprintf(nullptr, 0, format, va) + 1;
-//  if (strncmp(format, "[CALL]", 6) == 0)
-//      return length;
-    if (index == SYSTEM) {
-        logs[index].push_back(std::string());
+    char temp[256];
+    va_list copy;
+    va_copy(copy, va);
+    int length = vsnprintf(temp, sizeof(temp), format, copy) + 1;
+    va_end(copy);
+    const char* text = temp;
+    std::string large;
+    if (length > (int)sizeof(temp)) {
+        large.resize(length);
+        vsnprintf(large.data(), length, format, va);
+        text = large.data();
     }
-    else if (logs[index].empty()) {
-        logs[index].push_back(std::string());
+    if (LogQueue* queue = LoggerQueue()) {
+        queue->Push(index, LogQueue::TEXT, logs_job, text, length - 1);
+        return length;
     }
-    std::string& log = logs[index].back();
-    size_t offset = log.size();
-    log.resize(offset + length);
-    vsnprintf(log.data() + offset, length, format, va);
-    log.pop_back();
-
-    // Tab
-    for (size_t i = offset, j = 0; i < log.size(); ++i, ++j) {
-        char c = log[i];
-        if (c == '\n')
-            j = size_t(0) - 1;
-        if (c != '\t')
-            continue;
-        size_t tab = 8 - (j % 8);
-        log.replace(i, 1, tab, ' ');
-        i += tab - 1;
-        j += tab - 1;
-    }
-
-    // Breakline
-    bool first = true;
-    size_t len = log.size();
-    std::vector<std::string> appends;
-    appends.push_back(std::string());
-    for (size_t i = offset; i < log.size(); ++i) {
-        char c = log[i];
-        if (c == '\n') {
-            if (first) {
-                len = i;
-            }
-            first = false;
-            appends.push_back(std::string());
-            continue;
-        }
-        if (first) {
-            continue;
-        }
-        appends.back().push_back(c);
+    if (index == SYSTEM) {
+        logs[index].Break(logs_job);
     }
-    log.resize(len);
-    std::move(appends.begin() + 1, appends.end(), std::back_inserter(logs[index]));
-    logs_focus[index] = (int)logs[index].size() - 1;
-
-//  // Call
-//  if (logs[index].size() >= 2) {
-//      auto back1 = logs[index][logs[index].size() - 2];
-//      auto back2 = logs[index][logs[index].size() - 1];
-//      if (back1.size() >= back2.size() && back1.compare(0, back2.size(), back2) == 0) {
-//          logs[index].pop_back();
-//          logs[index].back() += '.';
-//      }
-//  }
+    logs[index].Append(text, length - 1, logs_job);
+    logs_focus[index] = (int)logs[index].Size() - 1;
 
     return length;
 }
@@ -89,3 +169,50 @@ static int Logger(const char* format, ...)
     va_end(va);
     return length;
 }
+
+template<int INDEX>
+static int LoggerDeferredV(const char* format, va_list va)
+{
+    int index = INDEX;
+    if (LogQueue* queue = LoggerQueue()) {
+        char payload[LogBuffer::PAYLOAD_SIZE];
+        size_t size = LogBuffer::Pack(format, va, payload, sizeof(payload));
+        queue->Push(index, LogQueue::DEFERRED, logs_job, payload, size);
+        return 0;
+    }
+    logs[index].Defer(format, va, logs_job);
+    logs_focus[index] = (int)logs[index].Size() - 1;
+    return 0;
+}
+
+template<int INDEX>
+static int LoggerDeferred(const char* format, ...)
+{
+    va_list va;
+    va_start(va, format);
+    int length = LoggerDeferredV<INDEX>(format, va);
+    va_end(va);
+    return length;
+}
+
+// CATEGORY 0 picks the category from the format, used by the emulator hooks
+template<uint32_t CATEGORY>
+static int TraceV(const char* format, va_list va)
+{
+    if constexpr (CATEGORY != 0 && (CATEGORY & TRACE_CATEGORIES) == 0)
+        return 0;
+    uint32_t category = CATEGORY ? CATEGORY : TraceCategory(format);
+    if ((category & trace_mask & TRACE_CATEGORIES) == 0)
+        return 0;
+    return LoggerDeferredV<SYSTEM>(format, va);
+}
+
+template<uint32_t CATEGORY>
+static int Trace(const char* format, ...)
+{
+    va_list va;
+    va_start(va, format);
+    int length = TraceV<CATEGORY>(format, va);
+    va_end(va);
+    return length;
+}
@@ -9,15 +9,21 @@
 #include <algorithm>
 #include <chrono>
 #include <map>
+#include <set>
+#include <string_view>
 #include <vector>
 #include "mine/mine.h"
 #include "mine/syscall/allocator.h"
 #include "src/AMDCompiler.h"
 #include "src/ATICompiler.h"
+#include "src/Catalog.h"
+#include "src/Container.h"
 #include "src/D3DCompiler.h"
+#include "src/LogFile.h"
 #include "src/MaliCompiler.h"
 #include "src/NVCompiler.h"
 #include "src/QCOMCompiler.h"
+#include "src/Timeline.h"
 #include "src/UnifiedExecution.h"
 #include "src/VirtualMachine.h"
 #include "ImGuiHelper.h"
@@ -28,6 +34,27 @@ static bool refresh_compiler;
 static bool refresh_machine;
 static std::chrono::system_clock::time_point begin_execute;
 
+struct Result {
+    std::map<std::string, ShaderCompiler::Output> outputs;
+    std::vector<std::string> console;
+};
+static std::map<std::string, Result> compiler_results;
+static std::map<std::string, Result> machine_results;
+static std::string compiler_key;
+static std::string machine_key;
+static size_t machine_console;
+
+static std::string index_path;
+static std::string log_path;
+static std::string trace_path;
+static std::string metrics_path;
+static std::string metrics_job;
+static std::string capture_path;
+static bool record_log;
+static bool record_metrics;
+static bool reload_catalog;
+static std::chrono::system_clock::time_point reload_time;
+
 static ImGuiID binary_dockid;
 static mine* cpu;
 static bool debug_vm;
@@ -59,6 +86,7 @@ int driver_index;
 int machine_index;
 
 std::map<std::string, Output> outputs;
+bool completed;
 
 int GetShaderType()
 {
@@ -148,6 +176,27 @@ static void LoadCompiler()
     types.push_back("Pixel");
 }
 
+static void LoadShaders()
+{
+    shaders.clear();
+    if (shader_path.empty() == false) {
+        DIR* dir = opendir(shader_path.c_str());
+        if (dir) {
+            while (struct dirent* dirent = readdir(dir)) {
+                if (dirent->d_name[0] == '.')
+                    continue;
+                if (strcasestr(dirent->d_name, ".asm") == nullptr &&
+                    strcasestr(dirent->d_name, ".glsl") == nullptr &&
+                    strcasestr(dirent->d_name, ".hlsl") == nullptr)
+                    continue;
+                shaders.push_back(dirent->d_name);
+            }
+            closedir(dir);
+        }
+    }
+    std::stable_sort(shaders.begin(), shaders.end());
+}
+
 static void LoadShader()
 {
     text.clear();
@@ -178,6 +227,30 @@ static void Text()
     ImGui::End();
 }
 
+// The machine binary as the driver returned it, benchmark/corpus measures it
+static void CaptureBinary()
+{
+    auto& binary = outputs["Machine"].binary;
+    if (binary.empty() || metrics_job.empty())
+        return;
+
+    std::string name = metrics_job;
+    for (auto& c : name) {
+        if (isalnum((unsigned char)c) == 0 && c != '-' && c != '.')
+            c = '_';
+    }
+    std::string path = capture_path + "/" + name + ".bin";
+    mkdir(capture_path.c_str(), 0755);
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        Logger<SYSTEM>("Capture : %s (%s)\n", "File can not be written", path.c_str());
+        return;
+    }
+    fwrite(binary.data(), 1, binary.size(), file);
+    fclose(file);
+    Logger<SYSTEM>("Capture : %s (%zu bytes)\n", path.c_str(), binary.size());
+}
+
 static void Option()
 {
     if (ImGui::Begin("Option")) {
@@ -249,15 +322,15 @@ static void Option()
         }
 
         // Machine
-        static std::vector<std::vector<std::string>> empty_machines;
+        static std::vector<Machine> empty_machines;
         auto& machines = (drivers.size() > driver_index) ? drivers[driver_index].machines : empty_machines;
         if (machine_index >= (int)machines.size())
             machine_index = (int)machines.size() - 1;
         ImGui::TextUnformatted("Machine");
         ImGui::SetNextItemWidth(region.x);
         if (ImGui::Combo("##206", &machine_index, [](void* user_data, int index) {
-            auto* machines = (std::vector<std::string>*)user_data;
-            return machines[index].front().c_str();
+            auto* machines = (Machine*)user_data;
+            return machines[index].name.c_str();
         }, machines.data(), (int)machines.size()) || ImGui::ScrollCombo(&machine_index, machines.size())) {
             refresh_machine = true;
         }
@@ -265,6 +338,33 @@ static void Option()
         // Debug
         ImGui::NewLine();
         ImGui::Checkbox("Debug Virtual Machine", &debug_vm);
+        ImGui::SameLine(region.x / 2);
+        if (ImGui::Checkbox("Emulate Disassembly", &D3DCompiler::emulate_disassembly)) {
+            compiler_results.clear();
+            refresh_compiler = true;
+        }
+        for (int i = 0; i < TRACE_COUNT; ++i) {
+            if (i % 4)
+                ImGui::SameLine(region.x * (i % 4) / 4);
+            ImGui::CheckboxFlags(trace_names[i], &trace_mask, 1u << i);
+        }
+        if (ImGui::Checkbox("Record Log", &record_log)) {
+            if (record_log) {
+                record_log = LogFile::Open(log_path);
+            }
+            else {
+                LogFile::Close();
+            }
+        }
+        ImGui::SameLine(region.x / 2);
+        ImGui::Checkbox("Record Metrics", &record_metrics);
+        if (ImGui::Button("Export Trace")) {
+            Timeline::Export(trace_path);
+        }
+        ImGui::SameLine(region.x / 2);
+        if (ImGui::Button("Capture Binary")) {
+            CaptureBinary();
+        }
         if (cpu) {
             auto allocator = cpu->Allocator;
             ImGui::Text("%08zX : %.2fMB", cpu->Program(), allocator->used_size() / 1048576.0f);
@@ -273,54 +373,162 @@ static void Option()
     ImGui::End();
 }
 
-static void Binary()
+static void HexWord(char* text, uint32_t value, int digits = 8)
 {
-    int id = 300;
+    // Spread the nibbles into bytes and turn all eight into hex digits at once
+    uint64_t x = value;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    uint64_t letters = ((x + 0x0606060606060606ull) >> 4) & 0x0101010101010101ull;
+    x = __builtin_bswap64(x + 0x3030303030303030ull + letters * 7);
+    char temp[8];
+    memcpy(temp, &x, 8);
+    memcpy(text, temp + 8 - digits, digits);
+}
 
-    auto hex = [](std::vector<char>& data, int& index) {
-        ImGui::ListBox("", &index, [](void* user_data, int index) -> const char* {
-            auto& binary = *(std::vector<char>*)user_data;
-            auto code = (uint32_t*)binary.data();
-            auto size = binary.size();
-            auto i = index * 16;
-
-            static char line[256];
-            int width = (4 + 10 + 10 + 10 + 10 + 1);
-            int offset = snprintf(line, 256, "%04X", i);
-            for (int j = 0; j < 16; j += 4) {
-                if ((i + j) >= size)
+static char* HexASCII(char* text, const uint8_t* bytes, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint64_t x;
+        memcpy(&x, bytes + i, 8);
+        uint64_t high = x & 0x8080808080808080ull;
+        uint64_t zero = (x - 0x0101010101010101ull) & ~x & 0x8080808080808080ull;
+        uint64_t line = x ^ 0x0A0A0A0A0A0A0A0Aull;
+        line = (line - 0x0101010101010101ull) & ~line & 0x8080808080808080ull;
+        if ((high | zero | line) != 0)
+            break;
+        memcpy(text, bytes + i, 8);
+        text += 8;
+    }
+    for (; i < count; ++i) {
+        uint8_t c = bytes[i];
+        if (c == 0x00 || c == '\n') {
+            (*text++) = ' ';
+        }
+        else if (c >= 0x01 && c <= 0x7F) {
+            (*text++) = c;
+        }
+        else {
+            for (int j = 0; j < 4; ++j) {
+                char u = eascii[c - 0x80][j];
+                if (u == 0)
                     break;
-                char c = (j == 0) ? ':' : ',';
-                offset += snprintf(line + offset, 256 - offset, "%c %08X", c, code[(i + j) / 4]);
-            }
-            if (width > offset) {
-                memset(line + offset, ' ', width - offset);
+                (*text++) = u;
             }
+        }
+    }
+    return text;
+}
 
-            char* ascii = line + width;
-            for (int j = 0; j < 16; ++j) {
-                if ((i + j) >= size)
-                    break;
-                uint8_t c = binary[i + j];
-                if (c == 0x00 || c == '\n') {
-                    (*ascii++) = ' ';
-                }
-                else if (c >= 0x01 && c <= 0x7F) {
-                    (*ascii++) = c;
-                }
-                else {
-                    for (int i = 0; i < 4; ++i) {
-                        char u = eascii[c - 0x80][i];
-                        if (u == 0)
-                            break;
-                        (*ascii++) = u;
-                    }
-                }
+static const char* HexLine(const std::vector<char>& binary, int index)
+{
+    // Small LRU of formatted rows, checked against the row bytes so a reused buffer never shows stale text
+    struct Row {
+        const void* data;
+        int index;
+        int count;
+        uint8_t bytes[16];
+        uint64_t stamp;
+        char line[128];
+    };
+    static Row rows[128];
+    static uint64_t stamp;
+
+    size_t offset = size_t(index) * 16;
+    int count = (int)std::min<size_t>(16, binary.size() - offset);
+    auto* bytes = (const uint8_t*)binary.data() + offset;
+
+    Row* row = &rows[0];
+    for (auto& cached : rows) {
+        if (cached.data == binary.data() && cached.index == index && cached.count == count && memcmp(cached.bytes, bytes, count) == 0) {
+            cached.stamp = ++stamp;
+            return cached.line;
+        }
+        if (cached.stamp < row->stamp) {
+            row = &cached;
+        }
+    }
+
+    row->data = binary.data();
+    row->index = index;
+    row->count = count;
+    row->stamp = ++stamp;
+    memset(row->bytes, 0, 16);
+    memcpy(row->bytes, bytes, count);
+
+    int digits = 4;
+    while (digits < 8 && (binary.size() - 1) >> (digits * 4))
+        digits++;
+
+    char* text = row->line;
+    HexWord(text, uint32_t(offset), digits);
+    text += digits;
+    for (int j = 0; j < 16; j += 4) {
+        if (j >= count)
+            break;
+        uint32_t word;
+        memcpy(&word, row->bytes + j, 4);
+        (*text++) = (j == 0) ? ':' : ',';
+        (*text++) = ' ';
+        HexWord(text, word);
+        text += 8;
+    }
+    char* ascii = row->line + digits + 10 + 10 + 10 + 10 + 1;
+    while (text < ascii)
+        (*text++) = ' ';
+    text = HexASCII(text, row->bytes, count);
+    (*text++) = 0;
+
+    return row->line;
+}
+
+static std::vector<std::pair<std::string, uint32_t>> HexSections(const std::vector<char>& binary)
+{
+    std::vector<std::pair<std::string, uint32_t>> sections;
+    for (auto& section : Container::Parse(Container::Span(binary.data(), binary.size()))) {
+        if (section.name.empty() == false)
+            sections.emplace_back(section.name, section.offset);
+    }
+    return sections;
+}
+
+static void Binary()
+{
+    int id = 300;
+
+    auto hex = [](std::vector<char>& data, int& index, const ImVec2& region) {
+        static std::map<const void*, std::string> offsets;
+        static int focus = -1;
+
+        // Jump to an offset or a section
+        auto& offset = offsets[&data];
+        ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8.0f);
+        if (ImGui::InputTextEx("##offset", "Offset", offset, ImVec2(0, 0), ImGuiInputTextFlags_CharsHexadecimal | ImGuiInputTextFlags_EnterReturnsTrue)) {
+            size_t value = strtoull(offset.c_str(), nullptr, 16);
+            if (value < data.size()) {
+                index = focus = int(value / 16);
             }
-            (*ascii++) = 0;
+        }
+        auto sections = HexSections(data);
+        if (sections.empty() == false) {
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x);
+            int section = -1;
+            if (ImGui::Combo("##section", &section, [](void* user_data, int index) {
+                auto& sections = *(std::vector<std::pair<std::string, uint32_t>>*)user_data;
+                return sections[index].first.c_str();
+            }, &sections, (int)sections.size())) {
+                index = focus = int(sections[section].second / 16);
+            }
+        }
 
-            return line;
+        ImGui::SetNextWindowSize(ImVec2(region.x, region.y - ImGui::GetFrameHeightWithSpacing()));
+        ImGui::ListBox("", &index, &focus, [](void* user_data, int index) -> const char* {
+            return HexLine(*(std::vector<char>*)user_data, index);
         }, &data, (int)(data.size() + 15) / 16);
+        focus = -1;
     };
 
     for (auto& [title, output] : outputs) {
@@ -332,8 +540,7 @@ static void Binary()
         if (ImGui::Begin(name, nullptr, ImGuiWindowFlags_NoFocusOnAppearing)) {
             ImVec2 region = ImGui::GetContentRegionAvail();
             ImGui::PushID(id++);
-            ImGui::SetNextWindowSize(region);
-            hex(output.binary, output.binary_index);
+            hex(output.binary, output.binary_index, region);
             ImGui::PopID();
         }
         ImGui::End();
@@ -342,9 +549,18 @@ static void Binary()
         snprintf(name, 64, "%s:%s", title.empty() ? "Output" : title.c_str(), "Disassembly");
         ImGui::DockBuilderDockWindow(name, binary_dockid);
         if (ImGui::Begin(name, nullptr, ImGuiWindowFlags_NoFocusOnAppearing)) {
+            static std::map<std::string, std::string> searches;
+            if (output.lines.empty() && output.disasm.empty() == false) {
+                output.lines.push_back(0);
+                for (size_t i = 0; i + 1 < output.disasm.size(); ++i) {
+                    if (output.disasm[i] == '\n') {
+                        output.lines.push_back(uint32_t(i + 1));
+                    }
+                }
+            }
             ImVec2 region = ImGui::GetContentRegionAvail();
             ImGui::PushID(id++);
-            ImGui::InputTextMultiline("", output.disasm, region, ImGuiInputTextFlags_ReadOnly);
+            ImGui::TextView("", output.disasm, output.lines, &output.disasm_index, searches[title], region);
             ImGui::PopID();
         }
         ImGui::End();
@@ -354,12 +570,18 @@ static void Binary()
 static void System()
 {
     if (ImGui::Begin("System")) {
+        if (logs[SYSTEM].Dropped()) {
+            ImGui::Text("%zu lines dropped", logs[SYSTEM].Dropped());
+        }
+        if (LoggerLost()) {
+            ImGui::Text("%zu records lost", LoggerLost());
+        }
         ImVec2 region = ImGui::GetContentRegionAvail();
         ImGui::SetNextWindowSize(region);
         ImGui::ListBox("##400", &logs_index[SYSTEM], &logs_focus[SYSTEM], [](void* user_data, int index) {
-            auto* logs = (std::string*)user_data;
-            return logs[index].c_str();
-        }, logs[SYSTEM].data(), (int)logs[SYSTEM].size());
+            auto* log = (LogBuffer*)user_data;
+            return log->Line(index);
+        }, &logs[SYSTEM], (int)logs[SYSTEM].Size());
         logs_focus[SYSTEM] = -1;
     }
     ImGui::End();
@@ -368,17 +590,66 @@ static void System()
 static void Console()
 {
     if (ImGui::Begin("Console")) {
+        if (logs[CONSOLE].Dropped()) {
+            ImGui::Text("%zu lines dropped", logs[CONSOLE].Dropped());
+        }
         ImVec2 region = ImGui::GetContentRegionAvail();
         ImGui::SetNextWindowSize(region);
         ImGui::ListBox("##500", &logs_index[CONSOLE], &logs_focus[CONSOLE], [](void* user_data, int index) {
-            auto* logs = (std::string*)user_data;
-            return logs[index].c_str();
-        }, logs[CONSOLE].data(), (int)logs[CONSOLE].size());
+            auto* log = (LogBuffer*)user_data;
+            return log->Line(index);
+        }, &logs[CONSOLE], (int)logs[CONSOLE].Size());
         logs_focus[CONSOLE] = -1;
     }
     ImGui::End();
 }
 
+static void Journal()
+{
+    static LogFile::Reader reader;
+    static int job_index = -1;
+    static int line_index;
+    static std::string text;
+    static std::vector<uint32_t> lines;
+    static std::string search;
+
+    if (ImGui::Begin("Log")) {
+        if (ImGui::Button("Load")) {
+            reader.Open(log_path);
+            job_index = -1;
+            text.clear();
+            lines.clear();
+        }
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x);
+        if (ImGui::Combo("##600", &job_index, [](void* user_data, int index) {
+            auto* jobs = (LogFile::Job*)user_data;
+            return jobs[index].name.c_str();
+        }, reader.jobs.data(), (int)reader.jobs.size())) {
+            std::vector<std::string> job_lines[2];
+            reader.Read(job_index, job_lines);
+            text.clear();
+            lines.clear();
+            line_index = 0;
+            for (auto* title : { "Console", "System" }) {
+                auto& input = job_lines[strcmp(title, "Console") == 0 ? CONSOLE : SYSTEM];
+                lines.push_back(uint32_t(text.size()));
+                text += "---- ";
+                text += title;
+                text += " ----\n";
+                for (auto& line : input) {
+                    lines.push_back(uint32_t(text.size()));
+                    text += line;
+                    text += '\n';
+                }
+            }
+        }
+        ImVec2 region = ImGui::GetContentRegionAvail();
+        ImGui::TextView("##601", text, lines, &line_index, search, region);
+    }
+    ImGui::End();
+}
+
 static void RefreshCompiler()
 {
     if (refresh_compiler == false)
@@ -391,10 +662,19 @@ static void RefreshCompiler()
     for (auto& [title, output] : outputs) {
         output.binary.clear();
         output.disasm.clear();
+        output.lines.clear();
+        output.instructions.clear();
+        output.opcodes.clear();
+        output.adreno = {};
     }
 
-    logs[SYSTEM].clear();
-    logs[CONSOLE].clear();
+    logs[SYSTEM].Clear();
+    logs[CONSOLE].Clear();
+    Timeline::Clear();
+
+    machine_results.clear();
+    compiler_key.clear();
+    machine_key.clear();
 
     if (compilers.size() > compiler_index) {
         auto& compiler = compilers[compiler_index];
@@ -414,6 +694,26 @@ static void RefreshCompiler()
 
         if (strcasestr(compiler.path.c_str(), "d3dx9") ||
             strcasestr(compiler.path.c_str(), "d3dcompiler")) {
+
+            // Compilers with identical code share their results
+            auto key = compiler.hash + '\0' + GetProfile() + '\0' + entry + '\0' + text;
+            int64_t lookup = Timeline::Now();
+            auto it = compiler_results.find(key);
+            Timeline::Record("Cache", lookup, Timeline::Now());
+            if (it != compiler_results.end()) {
+                auto& result = (*it).second;
+                for (auto& [title, output] : result.outputs) {
+                    outputs[title] = output;
+                }
+                for (auto& line : result.console) {
+                    Logger<CONSOLE>("%s\n", line.c_str());
+                }
+                return;
+            }
+            compiler_key = key;
+            LoggerJob();
+            LogFile::Begin(compiler.name + " : " + GetProfile() + " : " + entry);
+
             if (text.find('{') == std::string::npos) {
                 cpu = VirtualMachine::RunDLL(path, D3DCompiler::RunD3DAssemble, debug_vm);
             }
@@ -427,6 +727,48 @@ static void RefreshCompiler()
     }
 }
 
+// One JSON line per machine job with statistics, a sweep over a corpus is
+// ranked from this file instead of parsing the disassembly
+static void RecordMetrics()
+{
+    if (record_metrics == false)
+        return;
+
+    auto escape = [](const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    };
+
+    FILE* file = nullptr;
+    std::string shader = (shaders.size() > shader_index) ? shaders[shader_index] : std::string();
+    for (auto& [title, output] : outputs) {
+        auto& adreno = output.adreno;
+        if (adreno.valid == false)
+            continue;
+        if (file == nullptr)
+            file = fopen(metrics_path.c_str(), "ab");
+        if (file == nullptr)
+            return;
+        fprintf(file, "{\"shader\":\"%s\",\"job\":\"%s\",\"output\":\"%s\",\"adreno\":{"
+                      "\"instructions\":%d,\"instlen\":%d,\"nops\":%d,\"mov\":%d,\"cov\":%d,"
+                      "\"ss\":%d,\"sy\":%d,\"sstall\":%d,\"fullreg\":%d,\"halfreg\":%d,\"constlen\":%d,\"last_baryf\":%d,"
+                      "\"instrs_per_cat\":[%d,%d,%d,%d,%d,%d,%d,%d]}}\n",
+                escape(shader).c_str(), escape(metrics_job).c_str(), escape(title).c_str(),
+                adreno.instructions, adreno.instlen, adreno.nops, adreno.mov, adreno.cov,
+                adreno.ss, adreno.sy, adreno.sstall, adreno.fullreg, adreno.halfreg, adreno.constlen, adreno.last_baryf,
+                adreno.instrs_per_cat[0], adreno.instrs_per_cat[1], adreno.instrs_per_cat[2], adreno.instrs_per_cat[3],
+                adreno.instrs_per_cat[4], adreno.instrs_per_cat[5], adreno.instrs_per_cat[6], adreno.instrs_per_cat[7]);
+    }
+    if (file) {
+        fclose(file);
+    }
+}
+
 static void RefreshMachine()
 {
     auto& output = outputs[""];
@@ -444,15 +786,43 @@ static void RefreshMachine()
         if (title.empty() == false) {
             output.binary.clear();
             output.disasm.clear();
+            output.lines.clear();
+            output.instructions.clear();
+            output.opcodes.clear();
+            output.adreno = {};
         }
     }
 
-//  logs[SYSTEM].clear();
-//  logs[CONSOLE].clear();
+//  logs[SYSTEM].Clear();
+//  logs[CONSOLE].Clear();
+
+    machine_key.clear();
 
     if (drivers.size() > driver_index && drivers[driver_index].machines.size() > machine_index) {
         auto& driver = drivers[driver_index];
         if (driver.name.size() > 1) {
+            auto& machine = driver.machines[machine_index];
+            auto key = driver.hash + '\0' + machine.key;
+            metrics_job = driver.name[0] + " : " + machine.name;
+            int64_t lookup = Timeline::Now();
+            auto it = machine_results.find(key);
+            Timeline::Record("Cache", lookup, Timeline::Now());
+            if (it != machine_results.end()) {
+                auto& result = (*it).second;
+                for (auto& [title, output] : result.outputs) {
+                    outputs[title] = output;
+                }
+                for (auto& line : result.console) {
+                    Logger<CONSOLE>("%s\n", line.c_str());
+                }
+                RecordMetrics();
+                return;
+            }
+            machine_key = key;
+            machine_console = logs[CONSOLE].Total();
+            LoggerJob();
+            LogFile::Begin(driver.name[0] + " : " + machine.name);
+
             std::string path = driver_path + "/" + driver.name[1];
             cpu = VirtualMachine::RunDLL(path, UnifiedExecution::RunDriver, debug_vm);
             if (cpu) {
@@ -466,10 +836,14 @@ static void Loop()
 {
     if (cpu == nullptr)
         return;
+    LogFile::Sync();
 
+    // One interval per slice, the emulator yields to the frame every 16ms
+    int64_t slice = Timeline::Now();
     uint32_t begin = 0;
     for (;;) {
         if (cpu->Step(1000) == false) {
+            Timeline::Record("Execute", slice, Timeline::Now());
             Logger<SYSTEM>("%s", cpu->Disassemble(1).c_str());
             Logger<SYSTEM>("%s", cpu->Status().c_str());
 
@@ -481,10 +855,11 @@ static void Loop()
                 Logger<SYSTEM>("%s%08X : %08X", i == 0 ? ">" : " ", stack + i * 4, (*value));
             }
 
-            logs_index[CONSOLE] = (int)logs[CONSOLE].size();
-            logs_index[SYSTEM] = (int)logs[SYSTEM].size();
+            logs_index[CONSOLE] = (int)logs[CONSOLE].Size();
+            logs_index[SYSTEM] = (int)logs[SYSTEM].Size();
 
             mine* origin = cpu;
+            completed = false;
             cpu = D3DCompiler::NextProcess(origin);
             if (cpu == nullptr)
                 cpu = AMDCompiler::NextProcess(origin);
@@ -499,7 +874,35 @@ static void Loop()
             if (cpu == nullptr) {
                 auto end_execute = std::chrono::system_clock::now();
                 auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_execute - begin_execute).count();
-                Logger<CONSOLE>("Duration : %lldms\n", duration);
+
+                // Shared by every compiler with identical code, a fault or a
+                // failed call runs again next time instead of being replayed
+                if (compiler_key.empty() == false && completed) {
+                    auto& result = compiler_results[compiler_key];
+                    result.outputs[""] = outputs[""];
+                    result.console.clear();
+                    logs[CONSOLE].Copy(result.console, 0);
+                }
+                compiler_key.clear();
+
+                // Shared by every machine line producing the same call
+                if (machine_key.empty() == false) {
+                    if (completed) {
+                        auto& result = machine_results[machine_key];
+                        for (auto& [title, output] : outputs) {
+                            if (title.empty() == false) {
+                                result.outputs[title] = output;
+                            }
+                        }
+                        result.console.clear();
+                        logs[CONSOLE].Copy(result.console, machine_console);
+                    }
+                    machine_key.clear();
+                    RecordMetrics();
+                }
+
+                Logger<CONSOLE>("Duration : %.3fms\n", duration / 1000.0);
+                LogFile::End();
                 VirtualMachine::Close(origin);
             }
             return;
@@ -513,8 +916,100 @@ static void Loop()
 #endif
         if (begin == 0)
             begin = now;
-        if (begin < now - 16)
+        if (begin < now - 16) {
+            Timeline::Record("Execute", slice, Timeline::Now());
             break;
+        }
+    }
+}
+
+static void Reload()
+{
+    if (Catalog::Changed()) {
+        reload_catalog = true;
+        reload_time = std::chrono::system_clock::now();
+        return;
+    }
+
+    // Editors write in several steps, wait until the directories are quiet
+    if (reload_catalog == false)
+        return;
+    if (std::chrono::system_clock::now() - reload_time < std::chrono::milliseconds(250))
+        return;
+    reload_catalog = false;
+
+    // Shader
+    std::string shader = (shaders.size() > shader_index) ? shaders[shader_index] : std::string();
+    LoadShaders();
+    auto shader_it = std::find(shaders.begin(), shaders.end(), shader);
+    if (shader_it != shaders.end()) {
+        shader_index = int(shader_it - shaders.begin());
+    }
+    else {
+        shader_index = 0;
+        LoadShader();
+        refresh_compiler = true;
+        refresh_machine = true;
+    }
+
+    Compiler compiler = (compilers.size() > compiler_index) ? compilers[compiler_index] : Compiler();
+    Driver driver = (drivers.size() > driver_index) ? drivers[driver_index] : Driver();
+    Machine machine = (driver.machines.size() > machine_index) ? driver.machines[machine_index] : Machine();
+
+    std::vector<Compiler> reload_compilers;
+    std::vector<Driver> reload_drivers;
+    Catalog::Reload(compiler_path, driver_path, shader_path, index_path, reload_compilers, reload_drivers);
+    compilers.swap(reload_compilers);
+    drivers.swap(reload_drivers);
+
+    // Compiler
+    auto compiler_it = std::find_if(compilers.begin(), compilers.end(), [&](auto& item) {
+        return item.name == compiler.name;
+    });
+    compiler_index = (compiler_it != compilers.end()) ? int(compiler_it - compilers.begin()) : 0;
+    if (compiler_it == compilers.end() || (*compiler_it).hash != compiler.hash) {
+        LoadCompiler();
+        refresh_compiler = true;
+        refresh_machine = true;
+    }
+
+    // Driver
+    auto driver_it = std::find_if(drivers.begin(), drivers.end(), [&](auto& item) {
+        return driver.name.empty() == false && item.name.front() == driver.name.front();
+    });
+    driver_index = (driver_it != drivers.end()) ? int(driver_it - drivers.begin()) : 0;
+    if (driver_it == drivers.end() || (*driver_it).hash != driver.hash) {
+        refresh_machine = true;
+    }
+
+    // Machine
+    if (driver_it != drivers.end()) {
+        auto& machines = (*driver_it).machines;
+        auto machine_it = std::find_if(machines.begin(), machines.end(), [&](auto& item) {
+            return item.name == machine.name;
+        });
+        machine_index = (machine_it != machines.end()) ? int(machine_it - machines.begin()) : 0;
+        if (machine_it == machines.end() || (*machine_it).key != machine.key) {
+            refresh_machine = true;
+        }
+    }
+
+    // Drop results of images which are gone, results of unchanged images stay warm
+    std::set<std::string> hashes;
+    for (auto& compiler : compilers) {
+        hashes.insert(compiler.hash);
+    }
+    for (auto& driver : drivers) {
+        hashes.insert(driver.hash);
+    }
+    for (auto* results : { &compiler_results, &machine_results }) {
+        for (auto it = (*results).begin(); it != (*results).end();) {
+            if (hashes.count((*it).first.substr(0, (*it).first.find('\0'))) == 0) {
+                it = (*results).erase(it);
+                continue;
+            }
+            ++it;
+        }
     }
 }
 
@@ -539,6 +1034,7 @@ static void Init()
     ImGui::DockBuilderDockWindow("Output", right);
     ImGui::DockBuilderDockWindow("System", bottom);
     ImGui::DockBuilderDockWindow("Console", bottom);
+    ImGui::DockBuilderDockWindow("Log", bottom);
     ImGui::DockBuilderFinish(dockid);
 
     std::string cwd(1024, 0);
@@ -549,131 +1045,26 @@ static void Init()
     shader_path.resize(1024);
     realpath((cwd + "/../../../../../../shader").c_str(), shader_path.data());
     shader_path.resize(strlen(shader_path.c_str()));
-    if (shader_path.empty() == false) {
-        DIR* dir = opendir(shader_path.c_str());
-        if (dir) {
-            while (struct dirent* dirent = readdir(dir)) {
-                if (dirent->d_name[0] == '.')
-                    continue;
-                if (strcasestr(dirent->d_name, ".asm") == nullptr &&
-                    strcasestr(dirent->d_name, ".glsl") == nullptr &&
-                    strcasestr(dirent->d_name, ".hlsl") == nullptr)
-                    continue;
-                shaders.push_back(dirent->d_name);
-            }
-            closedir(dir);
-        }
-    }
-    std::stable_sort(shaders.begin(), shaders.end());
+    LoadShaders();
 
     compiler_path.resize(1024, 0);
     realpath((cwd + "/../../../../../../compiler").c_str(), compiler_path.data());
     compiler_path.resize(strlen(compiler_path.c_str()));
-    if (compiler_path.empty() == false) {
-        FILE* file = fopen((compiler_path + "/compiler.ini").c_str(), "rb");
-        if (file) {
-            char line[256];
-            while (fgets(line, 256, file)) {
-                Compiler compiler;
-                for (int i = 0; i < 256; ++i) {
-                    char c = line[i];
-                    if (c == 0 || c == '\r' || c == '\n')
-                        break;
-                    if (c == '=') {
-                        compiler.name.swap(compiler.path);
-                        continue;
-                    }
-                    compiler.name.push_back(c);
-                }
-                compilers.push_back(compiler);
-            }
-            fclose(file);
-        }
-
-        // Remove unavailable
-        struct stat st;
-        for (int64_t i = compilers.size() - 1; i >= 0; --i) {
-            auto path = compiler_path + "/" + compilers[i].path;
-            if (stat(path.c_str(), &st) != 0) {
-                compilers.erase(compilers.begin() + i);
-            }
-        }
-    }
 
     driver_path.resize(1024, 0);
     realpath((cwd + "/../../../../../../driver").c_str(), driver_path.data());
     driver_path.resize(strlen(driver_path.c_str()));
-    if (driver_path.empty() == false) {
-        FILE* file = fopen((driver_path + "/driver.ini").c_str(), "rb");
-        if (file) {
-            auto finish = []() {
-                for (auto& driver : drivers) {
-                    if (driver.machines.empty()) {
-                        driver.machines = drivers.back().machines;
-                    }
-                }
-            };
-
-            bool quotation_mark = false;
-            char line[256];
-            while (fgets(line, 256, file)) {
-                switch (line[0]) {
-                case 0:
-                    break;
-                case '[':
-                    finish();
-
-                    drivers.push_back(Driver());
-                    for (int i = 1; i < 256; ++i) {
-                        char c = line[i];
-                        if (c == 0 || c == '\r' || c == '\n' || c == ']')
-                            break;
-                        if (c == '=') {
-                            drivers.back().name.push_back(std::string());
-                            continue;
-                        }
-                        if (drivers.back().name.empty())
-                            drivers.back().name.push_back(std::string());
-                        drivers.back().name.back().push_back(c);
-                    }
-                    break;
-                default:
-                    std::vector<std::string> machine;
-                    for (int i = 0; i < 256; ++i) {
-                        char c = line[i];
-                        if (c == 0 || c == '\r' || c == '\n')
-                            break;
-                        if ((c == '=' || c == ',') && quotation_mark == false) {
-                            machine.push_back(std::string());
-                            continue;
-                        }
-                        if (c == '\"') {
-                            quotation_mark = !quotation_mark;
-                        }
-                        if (machine.empty())
-                            machine.push_back(std::string());
-                        machine.back().push_back(c);
-                    }
-                    if (drivers.empty() == false && machine.empty() == false) {
-                        drivers.back().machines.push_back(machine);
-                    }
-                    break;
-                }
-            }
-            fclose(file);
 
-            finish();
-        }
+    index_path.resize(1024, 0);
+    realpath((cwd + "/../../../../../..").c_str(), index_path.data());
+    index_path.resize(strlen(index_path.c_str()));
+    log_path = index_path + "/shader.log";
+    trace_path = index_path + "/trace.json";
+    metrics_path = index_path + "/metrics.jsonl";
+    capture_path = index_path + "/benchmark/corpus/capture";
+    index_path += "/catalog.idx";
 
-        // Remove unavailable
-        struct stat st;
-        for (int64_t i = drivers.size() - 1; i >= 0; --i) {
-            auto path = driver_path + "/" + drivers[i].name.back();
-            if (stat(path.c_str(), &st) != 0) {
-                drivers.erase(drivers.begin() + i);
-            }
-        }
-    }
+    Catalog::Load(compiler_path, driver_path, shader_path, index_path);
 
     LoadCompiler();
     LoadShader();
@@ -722,11 +1113,14 @@ bool ShaderCompilerGUI(ImVec2 screen)
         ImGui::PopStyleColor();
 
         Init();
+        Reload();
         Text();
         Option();
         Binary();
+        LoggerDrain();
         System();
         Console();
+        Journal();
         RefreshCompiler();
         RefreshMachine();
         Loop();
@@ -18,6 +18,7 @@ extern int shader_index;
 struct Compiler {
     std::string name;
     std::string path;
+    std::string hash;
 };
 extern std::vector<Compiler> compilers;
 extern int compiler_index;
@@ -30,21 +31,110 @@ extern int profile_index;
 extern std::vector<std::string> types;
 extern int type_index;
 
+struct Parameter {
+    enum Opcode : uint8_t {
+        PushImmediate,
+        PushString,
+        PushBuffer,
+        PushStack,
+    };
+    enum Buffer : uint32_t {
+        SrcData,
+        SrcDataSize,
+        SHDRData,
+        SHDRDataSize,
+        ShaderType,
+        Output,
+        OutputSize,
+        BufferCount,
+    };
+    Opcode opcode;
+    uint32_t value;
+};
+
+struct Machine {
+    std::string name;
+    std::string entry;
+    std::string strings;
+    std::vector<Parameter> parameters;
+    std::string key;
+};
+
 struct Driver {
     std::vector<std::string> name;
-    std::vector<std::vector<std::string>> machines;
+    std::vector<Machine> machines;
+    std::string hash;
 };
 extern std::vector<Driver> drivers;
 extern int driver_index;
 extern int machine_index;
 
+struct Instruction {
+    enum Unit : uint8_t {
+        None,
+        ALU,
+        Special,
+        Flow,
+        Memory,
+        Texture,
+        Varying,
+        Sync,
+    };
+    enum File : uint8_t {
+        Register = 1,
+        Constant,
+        Uniform,
+        Predicate,
+        Input,
+        Output,
+        Sampler,
+    };
+    static constexpr uint32_t Operand(File file, uint32_t index) { return (uint32_t(file) << 24) | (index & 0xFFFFFF); }
+    uint32_t offset;
+    uint16_t size;
+    uint16_t opcode;
+    uint8_t unit;
+    uint8_t count;
+    uint32_t operands[6];
+    uint32_t line;
+};
+
+// Counted by disasm_a3xx_stat, registers and constants in vec4 units as
+// shader-db reports them, instructions include (rptN) repeats and instlen
+// does not
+struct AdrenoStats {
+    bool valid = false;
+    int instructions = 0;
+    int instlen = 0;
+    int nops = 0;
+    int mov = 0;
+    int cov = 0;
+    int ss = 0;
+    int sy = 0;
+    int sstall = 0;
+    int fullreg = 0;
+    int halfreg = 0;
+    int constlen = 0;
+    int last_baryf = 0;
+    int instrs_per_cat[8] = {};
+};
+
 struct Output {
     std::vector<char> binary;
     std::string disasm;
+    std::vector<uint32_t> lines;
+    std::vector<Instruction> instructions;
+    std::vector<std::string> opcodes;
+    AdrenoStats adreno;
     int binary_index = 0;
+    int disasm_index = 0;
 };
 extern std::map<std::string, Output> outputs;
 
+// Set by the backend which took the result of a finished call, a job which
+// stops without it faulted or failed and is not kept in the result cache
+extern bool completed;
+
 extern int GetShaderType();
 extern std::string GetProfile();
 
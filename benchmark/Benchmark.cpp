@@ -0,0 +1,599 @@
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ShaderCompiler.h"
+#include "Sink.h"
+#include "../src/Container.h"
+#include "../src/D3DDisassembler.h"
+
+extern "C" {
+    FILE* mesa_context_create(void* sink, unsigned debug);
+    void mesa_context_destroy(FILE* fp);
+    size_t mesa_allocated(FILE* fp);
+#   include "../disassembler/adreno/disasm.h"
+#   include "../disassembler/utgard/gp/codegen.h"
+#   include "../disassembler/utgard/pp/codegen.h"
+#   include "../disassembler/midgard/disassemble.h"
+};
+
+// Decoder throughput of the native disassemblers
+//
+// Replays the raw binaries of benchmark/corpus through the decoders the
+// backends use, without the emulator or any vendor DLL, and prints one JSON
+// object per decoder with the time per instruction, the heap bytes of one
+// run and the peak resident size so far, two builds are compared line by
+// line. Midgard counts bundles as instructions.
+//
+// The corpus is built once from seeded random words, keeping the ones which
+// decode on their own without a warning and do not stop the shader, and is
+// checked in so a decoder change can not change what is measured.
+//
+// Real compiler output goes to corpus/capture, saved by Capture Binary in
+// the application as the driver returned it. The code section is found the
+// way the backends find it and each file is measured on its own line.
+//
+// The D3D listings are checked against golden/<name>.txt instead, the
+// instruction lines D3DDisassemble printed for golden/<name>.bin, compared
+// as D3DCompiler verifies them without comments and spacing.
+//
+//   Benchmark [corpus] [seconds]
+//   Benchmark --generate [corpus] [instructions]
+//   Benchmark --golden [directory]
+//
+// GCN is not part of it, AMD shaders are only disassembled by the vendor DLL.
+
+static size_t allocated = 0;
+
+void* operator new(size_t size)
+{
+    allocated += size;
+    if (void* pointer = malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+struct Decoder {
+    const char* name;
+    int gpu_id;
+    size_t (*Count)(const std::vector<uint32_t>& words);
+    void (*Disassemble)(Sink& sink, FILE* context, const std::vector<uint32_t>& words, int gpu_id);
+    std::vector<uint32_t> (*Generate)(const Decoder& decoder, size_t count);
+};
+
+static std::string Disassemble(const Decoder& decoder, const std::vector<uint32_t>& words, size_t* bytes = nullptr)
+{
+    ShaderCompiler::Output output;
+    Sink sink;
+    FILE* context = mesa_context_create(&sink, PRINT_RAW);
+    decoder.Disassemble(sink, context, words, decoder.gpu_id);
+    if (bytes) {
+        (*bytes) += mesa_allocated(context);
+    }
+    mesa_context_destroy(context);
+    sink.Flush(output);
+    return output.disasm;
+}
+
+static bool Clean(const std::string& text, std::initializer_list<const char*> rejects)
+{
+    if (text.empty())
+        return false;
+    for (const char* reject : rejects) {
+        if (text.find(reject) != std::string::npos)
+            return false;
+    }
+    return true;
+}
+
+// Adreno : 64-bit words
+static size_t AdrenoCount(const std::vector<uint32_t>& words)
+{
+    return words.size() / 2;
+}
+
+static void AdrenoDisassemble(Sink& sink, FILE* context, const std::vector<uint32_t>& words, int gpu_id)
+{
+    try_disasm_a3xx((uint32_t*)words.data(), int(words.size()), 0, context, gpu_id);
+}
+
+static std::vector<uint32_t> AdrenoGenerate(const Decoder& decoder, size_t count)
+{
+    std::mt19937 random(decoder.gpu_id);
+    std::vector<uint32_t> program;
+    for (size_t tries = 0; program.size() < count * 2 && tries < count * 1000; ++tries) {
+        std::vector<uint32_t> word = { uint32_t(random()), uint32_t(random()) };
+        if (Clean(Disassemble(decoder, word), { "WARNING", "error", "Assertion", "no match", "dontcare", "conflict", " end", "chsh" })) {
+            program.insert(program.end(), word.begin(), word.end());
+        }
+    }
+    return program;
+}
+
+// Midgard : bundles of 1 to 4 quadwords, the size follows from the tag in
+// the low 4 bits and the tag of the next bundle sits in the next 4 bits
+static constexpr uint32_t MIDGARD_TAG_BREAK = 0x1;
+static constexpr uint32_t MIDGARD_REGISTER_CONSTANT = 26;
+
+static size_t MidgardWords(uint32_t tag)
+{
+    return tag >= 0x8 ? ((tag & 3) + 1) * 4 : 4;
+}
+
+static size_t MidgardCount(const std::vector<uint32_t>& words)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < words.size(); i += MidgardWords(words[i] & 0xF)) {
+        count++;
+    }
+    return count;
+}
+
+static void MidgardDisassemble(Sink& sink, FILE* context, const std::vector<uint32_t>& words, int gpu_id)
+{
+    disassemble_midgard(context, words.data(), words.size() * sizeof(uint32_t), gpu_id, false);
+}
+
+static std::vector<uint32_t> MidgardGenerate(const Decoder& decoder, size_t count)
+{
+    // Units of an ALU bundle, enable bit in the control word and 16-bit
+    // words of the field, branches are left out as their targets would land
+    // outside of the program
+    static const uint32_t units[][2] = { { 17, 3 }, { 19, 2 }, { 21, 3 }, { 23, 2 }, { 25, 3 } };
+
+    std::mt19937 random(decoder.gpu_id + 'MIDG');
+    std::vector<uint32_t> program;
+    std::vector<size_t> bundles;
+    for (size_t tries = 0; bundles.size() < count && tries < count * 1000; ++tries) {
+        uint32_t control = 0;
+        uint32_t tag = 0x5;
+        bool constants = false;
+        switch (random() % 3) {
+        case 0:
+            tag = 0x3;
+            break;
+        case 1:
+            tag = 0x5;
+            break;
+        default:
+            // Control word, one register word per unit and the fields, with
+            // an optional quadword of constants after them
+            size_t halves = 2;
+            for (auto& unit : units) {
+                if (random() & 1) {
+                    control |= 1u << unit[0];
+                    halves += 1 + unit[1];
+                }
+            }
+            constants = random() & 1;
+            size_t quad_words = (halves + 7) / 8 + constants;
+            if (control == 0 || quad_words > 4)
+                continue;
+            tag = 0x8 + uint32_t(quad_words - 1);
+            break;
+        }
+        std::vector<uint32_t> bundle(MidgardWords(tag));
+        for (auto& word : bundle) {
+            word = uint32_t(random());
+        }
+        bundle[0] = control ? control : (bundle[0] & ~0xFF);
+        bundle[0] |= (MIDGARD_TAG_BREAK << 4) | tag;
+
+        // The register words follow the control word and the fields follow
+        // them. Without the quadword of constants no source may read them and
+        // vector fields work on 16, 32 or 64-bit lanes, 8-bit ones have no
+        // expanded sources
+        auto* reg = (uint16_t*)bundle.data() + 2;
+        auto* field = reg + __builtin_popcount(control);
+        for (auto& unit : units) {
+            if ((control & (1u << unit[0])) == 0)
+                continue;
+            if (constants == false) {
+                if (((*reg) & 0x1F) == MIDGARD_REGISTER_CONSTANT)
+                    (*reg) &= ~0x1F;
+                if (((*reg) >> 5 & 0x1F) == MIDGARD_REGISTER_CONSTANT && ((*reg) & 0x8000) == 0)
+                    (*reg) &= ~(0x1F << 5);
+            }
+            if (unit[1] == 3 && ((*field) >> 8 & 3) == 0)
+                (*field) |= 1 << 8;
+            reg += 1;
+            field += unit[1];
+        }
+        if (Clean(Disassemble(decoder, bundle), { "XXX", "nknown", "->", "break", "/*" })) {
+            bundles.push_back(program.size());
+            program.insert(program.end(), bundle.begin(), bundle.end());
+        }
+    }
+    for (size_t i = 0; i + 1 < bundles.size(); ++i) {
+        uint32_t next = program[bundles[i + 1]] & 0xF;
+        program[bundles[i]] = (program[bundles[i]] & ~0xF0) | (next << 4);
+    }
+    return program;
+}
+
+// Utgard GP : 128-bit instructions
+static size_t GPCount(const std::vector<uint32_t>& words)
+{
+    return words.size() / 4;
+}
+
+static void GPDisassemble(Sink& sink, FILE* context, const std::vector<uint32_t>& words, int gpu_id)
+{
+    gpir_disassemble_program((gpir_codegen_instr*)words.data(), unsigned(words.size() / 4), context);
+}
+
+static std::vector<uint32_t> GPGenerate(const Decoder& decoder, size_t count)
+{
+    // Sources may come from the previous instruction, the program starts
+    // with an empty one and every candidate is tried after the last one kept
+    std::mt19937 random(decoder.gpu_id + 'GP');
+    std::vector<uint32_t> program(4);
+    for (size_t tries = 0; program.size() < count * 4 && tries < count * 1000; ++tries) {
+        std::vector<uint32_t> instr(program.end() - 4, program.end());
+        instr.insert(instr.begin(), 4, 0);
+        for (size_t i = 0; i < 4; ++i) {
+            instr.push_back(uint32_t(random()));
+        }
+        if (Clean(Disassemble(decoder, instr), { "nknown" })) {
+            program.insert(program.end(), instr.end() - 4, instr.end());
+        }
+    }
+    return program;
+}
+
+// Utgard PP : a control word with the length in words and the fields present,
+// followed by the fields packed at their bit sizes
+static size_t PPCount(const std::vector<uint32_t>& words)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < words.size(); count++) {
+        auto* ctrl = (ppir_codegen_ctrl*)&words[i];
+        if (ctrl->count == 0)
+            break;
+        i += ctrl->count;
+    }
+    return count;
+}
+
+static void PPDisassemble(Sink& sink, FILE* context, const std::vector<uint32_t>& words, int gpu_id)
+{
+    for (size_t offset = 0; offset < words.size(); ) {
+        auto* ctrl = (ppir_codegen_ctrl*)&words[offset];
+        if (ctrl->count == 0)
+            break;
+        sink.Print("@%6d: ", int(offset));
+        ppir_disassemble_instr((uint32_t*)&words[offset], unsigned(offset), context);
+        offset += ctrl->count;
+    }
+}
+
+static std::vector<uint32_t> PPGenerate(const Decoder& decoder, size_t count)
+{
+    static const int sizes[ppir_codegen_field_shift_count] = { 34, 62, 41, 43, 30, 44, 31, 30, 41, 73, 64, 64 };
+
+    std::mt19937 random(decoder.gpu_id + 'PP');
+    std::vector<uint32_t> program;
+    for (size_t tries = 0, instrs = 0; instrs < count && tries < count * 1000; ++tries) {
+        ppir_codegen_ctrl ctrl = {};
+        ctrl.fields = uint32_t(random()) & ((1 << ppir_codegen_field_shift_count) - 1);
+        ctrl.fields &= ~(1 << ppir_codegen_field_shift_branch);
+        int bits = 0;
+        for (int i = 0; i < ppir_codegen_field_shift_count; ++i) {
+            if (ctrl.fields & (1 << i))
+                bits += sizes[i];
+        }
+        if (bits == 0)
+            continue;
+        ctrl.count = 1 + (bits + 31) / 32;
+        std::vector<uint32_t> instr(ctrl.count);
+        for (auto& word : instr) {
+            word = uint32_t(random());
+        }
+        instr[0] = ctrl.mask;
+        if (Clean(Disassemble(decoder, instr), { "nknown", "stop" })) {
+            program.insert(program.end(), instr.begin(), instr.end());
+            instrs++;
+        }
+    }
+    return program;
+}
+
+static const Decoder decoders[] = {
+    { "a3xx", 300, AdrenoCount, AdrenoDisassemble, AdrenoGenerate },
+    { "a4xx", 400, AdrenoCount, AdrenoDisassemble, AdrenoGenerate },
+    { "a5xx", 500, AdrenoCount, AdrenoDisassemble, AdrenoGenerate },
+    { "a6xx", 600, AdrenoCount, AdrenoDisassemble, AdrenoGenerate },
+    { "a7xx", 700, AdrenoCount, AdrenoDisassemble, AdrenoGenerate },
+    { "midgard", 0, MidgardCount, MidgardDisassemble, MidgardGenerate },
+    { "utgard-gp", 0, GPCount, GPDisassemble, GPGenerate },
+    { "utgard-pp", 0, PPCount, PPDisassemble, PPGenerate },
+};
+
+static size_t PeakRSS()
+{
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return size_t(usage.ru_maxrss);
+#else
+    return size_t(usage.ru_maxrss) * 1024;
+#endif
+}
+
+static std::string Path(const std::string& corpus, const Decoder& decoder)
+{
+    return corpus + "/" + decoder.name + ".bin";
+}
+
+static bool Load(const std::string& path, std::vector<char>& data)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+    data.clear();
+    char buffer[4096];
+    for (size_t size; (size = fread(buffer, 1, sizeof(buffer), file)) != 0; ) {
+        data.insert(data.end(), buffer, buffer + size);
+    }
+    fclose(file);
+    return true;
+}
+
+// Sorted, so two runs print the files in the same order
+static std::vector<std::string> List(const std::string& directory, const char* extension)
+{
+    std::vector<std::string> names;
+    size_t length = strlen(extension);
+    if (DIR* dir = opendir(directory.c_str())) {
+        while (struct dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() > length && name.compare(name.size() - length, length, extension) == 0)
+                names.push_back(name);
+        }
+        closedir(dir);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static const Decoder* Find(const char* name)
+{
+    for (auto& decoder : decoders) {
+        if (strcmp(decoder.name, name) == 0)
+            return &decoder;
+    }
+    return nullptr;
+}
+
+static std::vector<uint32_t> Words(Container::Span span)
+{
+    std::vector<uint32_t> words(span.size / sizeof(uint32_t));
+    if (words.empty() == false)
+        memcpy(words.data(), span.data, words.size() * sizeof(uint32_t));
+    return words;
+}
+
+// The section QCOMCompiler and MaliCompiler disassemble, with its decoder
+static const Decoder* Extract(const std::vector<char>& binary, std::vector<uint32_t>& program)
+{
+    static const char* const adreno[] = { "a3xx", "a4xx", "a5xx", "a6xx", "a7xx" };
+
+    // Adreno binaries carry no magic, everything which is not MBS is taken for one
+    Container::Span datas(binary.data(), binary.size());
+    if (Container::Identify(datas) == Container::Format::MBS) {
+        auto sections = Container::Parse(datas, Container::Format::MBS);
+        for (auto& section : sections) {
+            if (section.name != "DBIN" && section.name != "OBJC")
+                continue;
+            program = Words(section.data);
+            if (section.name == "OBJC")
+                return Find("midgard");
+            for (int parent = section.parent; parent >= 0; parent = sections[parent].parent) {
+                if (sections[parent].name == "CVER")
+                    return Find("utgard-gp");
+                if (sections[parent].name == "CFRA")
+                    return Find("utgard-pp");
+            }
+            return nullptr;
+        }
+        return nullptr;
+    }
+
+    uint32_t section_binary = datas.Word(4);
+    uint32_t section_gpu = datas.Word(16);
+    for (auto& section : Container::Parse(datas, Container::Format::QCOM)) {
+        if (section.id == section_binary) {
+            program = Words(section.data);
+            return Find(adreno[section_gpu < 5 ? section_gpu : 0]);
+        }
+    }
+    return nullptr;
+}
+
+static void Measure(const Decoder& decoder, const std::vector<uint32_t>& program, const std::string& source, double seconds)
+{
+    size_t instructions = decoder.Count(program);
+
+    // The first run is not timed, it builds the tables of the decoder
+    size_t bytes = 0;
+    Disassemble(decoder, program);
+    allocated = 0;
+    Disassemble(decoder, program, &bytes);
+    bytes += allocated;
+
+    size_t runs = 0;
+    auto begin = std::chrono::steady_clock::now();
+    auto end = begin;
+    while (runs == 0 || std::chrono::duration<double>(end - begin).count() < seconds) {
+        Disassemble(decoder, program);
+        runs++;
+        end = std::chrono::steady_clock::now();
+    }
+
+    double elapsed = std::chrono::duration<double>(end - begin).count();
+    printf("{\"decoder\":\"%s\",\"source\":\"%s\",\"instructions\":%zu,\"runs\":%zu,\"ns_per_instruction\":%.2f,\"bytes_allocated\":%zu,\"peak_rss\":%zu}\n",
+           decoder.name, source.c_str(), instructions, runs, elapsed * 1e9 / double(std::max<size_t>(instructions, 1) * runs), bytes, PeakRSS());
+}
+
+static int Generate(const std::string& corpus, size_t count)
+{
+    for (auto& decoder : decoders) {
+        std::vector<uint32_t> program = decoder.Generate(decoder, count);
+        std::string path = Path(corpus, decoder);
+        FILE* file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            fprintf(stderr, "%s : can not be written\n", path.c_str());
+            return 1;
+        }
+        fwrite(program.data(), sizeof(uint32_t), program.size(), file);
+        fclose(file);
+        printf("%s : %zu instructions\n", path.c_str(), decoder.Count(program));
+    }
+    return 0;
+}
+
+// The next line which is not empty or a comment, without spacing
+static bool Line(const std::vector<char>& text, size_t& offset, std::string& line)
+{
+    while (offset < text.size()) {
+        line.clear();
+        for (; offset < text.size() && text[offset] != '\n'; ++offset) {
+            if (isspace((unsigned char)text[offset]) == 0)
+                line += text[offset];
+        }
+        offset++;
+        if (line.empty() == false && line.compare(0, 2, "//") != 0)
+            return true;
+    }
+    return false;
+}
+
+static int Golden(const std::string& golden)
+{
+    int failed = 0;
+    for (auto& name : List(golden, ".bin")) {
+        std::string stem = name.substr(0, name.size() - 4);
+        std::vector<char> binary;
+        std::vector<char> expected;
+        if (Load(golden + "/" + name, binary) == false || Load(golden + "/" + stem + ".txt", expected) == false) {
+            fprintf(stderr, "%s : no listing\n", stem.c_str());
+            failed++;
+            continue;
+        }
+
+        ShaderCompiler::Output output;
+        Sink sink;
+        bool supported = D3DDisassembler::Disassemble(sink, binary.data(), binary.size());
+        sink.Flush(output);
+        std::vector<char> native(output.disasm.begin(), output.disasm.end());
+
+        size_t expected_offset = 0;
+        size_t native_offset = 0;
+        std::string expected_line;
+        std::string native_line;
+        int count = 0;
+        bool match = supported;
+        while (match) {
+            bool expected_more = Line(expected, expected_offset, expected_line);
+            bool native_more = Line(native, native_offset, native_line);
+            if (expected_more == false && native_more == false)
+                break;
+            if (expected_more != native_more || expected_line != native_line) {
+                fprintf(stderr, "%s : line %d differs\n", stem.c_str(), count + 1);
+                fprintf(stderr, "  Golden : %s\n", expected_more ? expected_line.c_str() : "");
+                fprintf(stderr, "  Native : %s\n", native_more ? native_line.c_str() : "");
+                match = false;
+            }
+            count++;
+        }
+        printf("{\"golden\":\"%s\",\"supported\":%s,\"match\":%s}\n", stem.c_str(), supported ? "true" : "false", match ? "true" : "false");
+        failed += match == false;
+    }
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::string corpus = __FILE__;
+    corpus = corpus.substr(0, corpus.find_last_of('/') + 1) + "corpus";
+
+    if (argc > 1 && strcmp(argv[1], "--golden") == 0) {
+        std::string golden = corpus.substr(0, corpus.find_last_of('/') + 1) + "golden";
+        return Golden(argc > 2 ? argv[2] : golden);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--generate") == 0) {
+        if (argc > 2)
+            corpus = argv[2];
+        size_t count = argc > 3 ? strtoul(argv[3], nullptr, 10) : 1000;
+        return Generate(corpus, count);
+    }
+    if (argc > 1)
+        corpus = argv[1];
+    double seconds = argc > 2 ? strtod(argv[2], nullptr) : 1.0;
+
+    for (auto& decoder : decoders) {
+        std::string path = Path(corpus, decoder);
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            fprintf(stderr, "%s : not found\n", path.c_str());
+            continue;
+        }
+        std::vector<uint32_t> program;
+        uint32_t word;
+        while (fread(&word, sizeof(word), 1, file) == 1) {
+            program.push_back(word);
+        }
+        fclose(file);
+        Measure(decoder, program, "generated", seconds);
+    }
+
+    for (auto& name : List(corpus + "/capture", ".bin")) {
+        std::string path = corpus + "/capture/" + name;
+        std::vector<char> binary;
+        if (Load(path, binary) == false)
+            continue;
+        std::vector<uint32_t> program;
+        const Decoder* decoder = Extract(binary, program);
+        if (decoder == nullptr || program.empty()) {
+            fprintf(stderr, "%s : no code section\n", path.c_str());
+            continue;
+        }
+        Measure(*decoder, program, name, seconds);
+    }
+    return 0;
+}
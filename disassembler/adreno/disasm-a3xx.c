@@ -16,8 +16,6 @@
 #include "instr-a3xx.h"
 #include "ir3.h"
 
-static enum debug_t debug;
-
 static const char *levels[] = {
    "",
    "\t",
@@ -92,6 +90,15 @@ struct disasm_ctx {
    gpr_bitset half_aliases;
 
    struct shader_stats *stats;
+
+   /**
+    * Instruction record accumulated while decoding the current instruction
+    */
+   struct {
+      const char *opcode;
+      unsigned count;
+      uint32_t operands[6];
+   } record;
 };
 
 static void
@@ -429,6 +436,9 @@ disasm_field_cb(void *d, const char *field_name, struct isa_decode_value *val)
    struct disasm_ctx *ctx = d;
 
    if (!strcmp(field_name, "NAME")) {
+      if (!ctx->record.opcode)
+         ctx->record.opcode = val->str;
+
       if (!strcmp("nop", val->str)) {
          if (ctx->has_end) {
             ctx->nop_count++;
@@ -488,7 +498,9 @@ disasm_field_cb(void *d, const char *field_name, struct isa_decode_value *val)
        */
       ctx->reg.r = true;
 
-      if (ctx->last.alias && ctx->last.alias_scope == ALIAS_TEX) {
+      /* shared registers (r48.x and up) are outside of the alias sets */
+      if (ctx->last.alias && ctx->last.alias_scope == ALIAS_TEX &&
+          val->num < GPR_REG_SIZE) {
          if (ctx->last.alias_full) {
             BITSET_SET(ctx->full_aliases, val->num);
          } else {
@@ -506,12 +518,20 @@ disasm_field_cb(void *d, const char *field_name, struct isa_decode_value *val)
       if (ctx->reg.r)
          num += ctx->last.repeat;
 
+      if (ctx->reg.file && ctx->reg.file != FILE_RT &&
+          ctx->record.count < ARRAY_SIZE(ctx->record.operands)) {
+         enum mesa_file file = (ctx->reg.file == FILE_CONST) ?
+            MESA_FILE_CONSTANT : MESA_FILE_REGISTER;
+         ctx->record.operands[ctx->record.count++] = MESA_OPERAND(file, num);
+      }
+
       if (ctx->reg.file == FILE_CONST) {
          ctx->stats->constlen = MAX2(ctx->stats->constlen, num);
       } else if (ctx->reg.file == FILE_GPR) {
-         if (ctx->reg.half && !BITSET_TEST(ctx->half_aliases, num)) {
+         bool tracked = num < GPR_REG_SIZE;
+         if (ctx->reg.half && !(tracked && BITSET_TEST(ctx->half_aliases, num))) {
             ctx->stats->halfreg = MAX2(ctx->stats->halfreg, num);
-         } else if (!BITSET_TEST(ctx->full_aliases, num)){
+         } else if (!(tracked && BITSET_TEST(ctx->full_aliases, num))) {
             ctx->stats->fullreg = MAX2(ctx->stats->fullreg, num);
          }
       }
@@ -594,12 +614,36 @@ disasm_instr_cb(void *d, unsigned n, void *instr)
 
    ctx->cur_opc_cat = opc_cat;
 
-   if (debug & PRINT_RAW) {
+   if (mesa_debug(ctx->out) & PRINT_RAW) {
       fprintf(ctx->out, "%s:%d:%04d:%04d[%08xx_%08xx] ", levels[ctx->level],
               opc_cat, n, ctx->extra_cycles + n, dwords[1], dwords[0]);
    }
 }
 
+static void
+disasm_post_instr_cb(void *d, unsigned n, void *instr)
+{
+   static const char *cats[] = {
+      "cat0", "cat1", "cat2", "cat3", "cat4", "cat5", "cat6", "cat7",
+   };
+   static const enum mesa_unit units[] = {
+      MESA_UNIT_FLOW, MESA_UNIT_ALU, MESA_UNIT_ALU, MESA_UNIT_ALU,
+      MESA_UNIT_SPECIAL, MESA_UNIT_TEXTURE, MESA_UNIT_MEMORY, MESA_UNIT_SYNC,
+   };
+   struct disasm_ctx *ctx = d;
+   const char *opcode = ctx->record.opcode ? ctx->record.opcode : cats[ctx->cur_opc_cat];
+   enum mesa_unit unit = units[ctx->cur_opc_cat];
+
+   if (!strcmp(opcode, "bary.f") || !strcmp(opcode, "flat.b") ||
+       !strcmp(opcode, "ldlv"))
+      unit = MESA_UNIT_VARYING;
+
+   mesa_instruction(ctx->out, n * 8, 8, opcode, unit, ctx->record.operands,
+                    ctx->record.count);
+
+   memset(&ctx->record, 0, sizeof(ctx->record));
+}
+
 int
 disasm_a3xx_stat(uint32_t *dwords, int sizedwords, int level, FILE *out,
                  unsigned gpu_id, struct shader_stats *stats)
@@ -611,6 +655,7 @@ disasm_a3xx_stat(uint32_t *dwords, int sizedwords, int level, FILE *out,
       .branch_labels = true,
       .field_cb = disasm_field_cb,
       .pre_instr_cb = disasm_instr_cb,
+      .post_instr_cb = disasm_post_instr_cb,
    };
    struct disasm_ctx ctx = {
       .out = out,
@@ -630,22 +675,19 @@ disasm_a3xx_stat(uint32_t *dwords, int sizedwords, int level, FILE *out,
 
    disasm_handle_last(&ctx);
 
-   if (debug & PRINT_STATS)
+   stats->instlen = ctx.cur_n + 1;
+   stats->instructions = ctx.cur_n + ctx.extra_cycles + 1;
+
+   if (mesa_debug(out) & PRINT_STATS)
       print_stats(&ctx);
 
    return 0;
 }
 
-void
-disasm_a3xx_set_debug(enum debug_t d)
-{
-   debug = d;
-}
-
 #include <setjmp.h>
 
-static bool jmp_env_valid;
-static jmp_buf jmp_env;
+static _Thread_local bool jmp_env_valid;
+static _Thread_local jmp_buf jmp_env;
 
 void
 ir3_assert_handler(const char *expr, const char *file, int line,
@@ -680,7 +722,15 @@ try_disasm_a3xx(uint32_t *dwords, int sizedwords, int level, FILE *out,
                 unsigned gpu_id)
 {
    struct shader_stats stats;
+   return try_disasm_a3xx_stat(dwords, sizedwords, level, out, gpu_id, &stats);
+}
+
+int
+try_disasm_a3xx_stat(uint32_t *dwords, int sizedwords, int level, FILE *out,
+                     unsigned gpu_id, struct shader_stats *stats)
+{
    int ret = -1;
-   TRY(ret = disasm_a3xx_stat(dwords, sizedwords, level, out, gpu_id, &stats));
+   memset(stats, 0, sizeof(*stats));
+   TRY(ret = disasm_a3xx_stat(dwords, sizedwords, level, out, gpu_id, stats));
    return ret;
 }
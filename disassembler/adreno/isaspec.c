@@ -40,17 +40,18 @@ isa_print(struct isa_print_state *state, const char *fmt, ...)
 	va_end(args);
 
 	if (ret != -1) {
-		const size_t len = strlen(buffer);
+		const size_t len = ret;
+		size_t line = len;
 
-		for (size_t i = 0; i < len; i++) {
-			const char c = buffer[i];
+		fwrite(buffer, 1, len, state->out);
 
-			fputc(c, state->out);
-			state->line_column++;
+		while (line > 0 && buffer[line - 1] != '\n')
+			line--;
 
-			if (c == '\n') {
-				state->line_column = 0;
-			}
+		if (line > 0) {
+			state->line_column = len - line;
+		} else {
+			state->line_column += len;
 		}
 
 		free(buffer);
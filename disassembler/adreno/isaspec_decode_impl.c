@@ -27,6 +27,7 @@
 
 #include <assert.h>
 #include <inttypes.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -277,32 +278,232 @@ evaluate_expr(struct decode_scope *scope, isa_expr_t expr)
 }
 
 /**
- * Find the bitset in NULL terminated bitset hiearchy root table which
- * matches against 'val'
+ * Fixed-width bitmask_t operations.
+ *
+ * The BITSET helpers loop over words and handle any width.  When the whole
+ * instruction fits in 64 bits, as it does for ir3, these collapse into
+ * plain 64-bit arithmetic; the width test is a constant expression so the
+ * word loops are only kept for wider instruction sets.
  */
-static const struct isa_bitset *
-find_bitset(struct decode_state *state, const struct isa_bitset **bitsets,
-		bitmask_t val)
+#define BITMASK_64 (sizeof(bitmask_t) == sizeof(uint64_t))
+
+static inline bitmask_t
+bitmask_and(bitmask_t a, bitmask_t b)
 {
-	const struct isa_bitset *match = NULL;
-	for (int n = 0; bitsets[n]; n++) {
-		if (state->options->gpu_id > bitsets[n]->gen.max)
+	if (BITMASK_64)
+		return uint64_t_to_bitmask(bitmask_to_uint64_t(a) & bitmask_to_uint64_t(b));
+
+	bitmask_t r;
+	BITSET_AND(r.bitset, a.bitset, b.bitset);
+	return r;
+}
+
+static inline bool
+bitmask_equal(bitmask_t a, bitmask_t b)
+{
+	if (BITMASK_64)
+		return bitmask_to_uint64_t(a) == bitmask_to_uint64_t(b);
+
+	return BITSET_EQUAL(a.bitset, b.bitset);
+}
+
+static inline bool
+bitmask_empty(bitmask_t a)
+{
+	if (BITMASK_64)
+		return bitmask_to_uint64_t(a) == 0;
+
+	return BITSET_IS_EMPTY(a.bitset);
+}
+
+/* (val & mask & ~dontcare) == match */
+static inline bool
+bitmask_match(bitmask_t val, const struct isa_bitset *bitset)
+{
+	if (BITMASK_64) {
+		uint64_t care = bitmask_to_uint64_t(bitset->mask) &
+				~bitmask_to_uint64_t(bitset->dontcare);
+		return (bitmask_to_uint64_t(val) & care) == bitmask_to_uint64_t(bitset->match);
+	}
+
+	bitmask_t m, not_dontcare;
+
+	BITSET_AND(m.bitset, val.bitset, bitset->mask.bitset);
+
+	BITSET_COPY(not_dontcare.bitset, bitset->dontcare.bitset);
+	BITSET_NOT(not_dontcare.bitset);
+
+	BITSET_AND(m.bitset, m.bitset, not_dontcare.bitset);
+
+	return BITSET_EQUAL(m.bitset, bitset->match.bitset);
+}
+
+/* val[high:low] shifted down to bit 0 */
+static inline bitmask_t
+bitmask_extract(bitmask_t val, unsigned low, unsigned high)
+{
+	if (BITMASK_64) {
+		uint64_t bits = bitmask_to_uint64_t(val) >> low;
+		if (high - low < 63)
+			bits &= (UINT64_C(1) << (high - low + 1)) - 1;
+		return uint64_t_to_bitmask(bits);
+	}
+
+	bitmask_t mask;
+
+	BITSET_ZERO(mask.bitset);
+
+	BITSET_SET_RANGE(mask.bitset, low, high);
+	BITSET_AND(val.bitset, val.bitset, mask.bitset);
+	BITSET_SHR(val.bitset, low);
+
+	return val;
+}
+
+/**
+ * Jump table over one NULL terminated bitset table for one gpu_id.
+ *
+ * Bitsets of other generations are dropped when the table is built.  The
+ * bits which every remaining bitset compares against select a bucket, and
+ * since a bitset can only match a value which agrees with it on those bits
+ * the bucket of a value holds every bitset which could match it, in the
+ * original order.  Tables are built on first use and kept for the life of
+ * the process, outside of the ralloc arena of a single disassembly.  They
+ * are published with a compare-and-swap, so disassemblies on other threads
+ * either see a complete table or build their own copy.
+ */
+#define DECODE_TABLE_BITS 10
+
+struct decode_table {
+	const struct isa_bitset **bitsets;
+	unsigned gpu_id;
+	unsigned num_bits;
+	unsigned bits[DECODE_TABLE_BITS];
+	unsigned *offsets;
+	const struct isa_bitset **entries;
+	struct decode_table *next;
+};
+
+static _Atomic(struct decode_table *) decode_tables[64];
+
+static unsigned
+decode_table_key(const struct isa_bitset *bitset, const unsigned *bits, unsigned num_bits)
+{
+	unsigned key = 0;
+	for (unsigned i = 0; i < num_bits; i++)
+		key = (key << 1) | BITSET_TEST(bitset->match.bitset, bits[i]);
+	return key;
+}
+
+static struct decode_table *
+decode_table_build(const struct isa_bitset **bitsets, unsigned gpu_id)
+{
+	struct decode_table *table = calloc(1, sizeof(*table));
+	table->bitsets = bitsets;
+	table->gpu_id = gpu_id;
+
+	unsigned total = 0;
+	while (bitsets[total])
+		total++;
+
+	const struct isa_bitset **candidates = calloc(total + 1, sizeof(*candidates));
+	unsigned count = 0;
+	bitmask_t common;
+	BITSET_ONES(common.bitset);
+	for (unsigned n = 0; n < total; n++) {
+		if (gpu_id > bitsets[n]->gen.max)
 			continue;
-		if (state->options->gpu_id < bitsets[n]->gen.min)
+		if (gpu_id < bitsets[n]->gen.min)
 			continue;
+		candidates[count++] = bitsets[n];
 
-		// m = (val & bitsets[n]->mask) & ~bitsets[n]->dontcare;
-		bitmask_t m = { 0 };
-		bitmask_t not_dontcare;
+		bitmask_t care;
+		BITSET_COPY(care.bitset, bitsets[n]->dontcare.bitset);
+		BITSET_NOT(care.bitset);
+		BITSET_AND(care.bitset, care.bitset, bitsets[n]->mask.bitset);
+		BITSET_AND(common.bitset, common.bitset, care.bitset);
+	}
 
-		BITSET_AND(m.bitset, val.bitset, bitsets[n]->mask.bitset);
+	/* Greedily take the common bit which spreads the candidates best */
+	unsigned histogram[1 << DECODE_TABLE_BITS];
+	unsigned long best_cost = (unsigned long)count * count;
+	while (count > 1 && table->num_bits < DECODE_TABLE_BITS) {
+		int best_bit = -1;
+		for (unsigned b = 0; b < BITSET_SIZE(common.bitset); b++) {
+			if (!BITSET_TEST(common.bitset, b))
+				continue;
+			table->bits[table->num_bits] = b;
+			memset(histogram, 0, sizeof(unsigned) << (table->num_bits + 1));
+			unsigned long cost = 0;
+			for (unsigned n = 0; n < count; n++) {
+				unsigned key = decode_table_key(candidates[n], table->bits, table->num_bits + 1);
+				cost += 2 * histogram[key]++ + 1;
+			}
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_bit = b;
+			}
+		}
+		if (best_bit < 0)
+			break;
+		BITSET_CLEAR(common.bitset, best_bit);
+		table->bits[table->num_bits++] = best_bit;
+		if (best_cost == count)
+			break;
+	}
+
+	unsigned buckets = 1u << table->num_bits;
+	table->offsets = calloc(buckets + 1, sizeof(unsigned));
+	table->entries = calloc(count + buckets, sizeof(*table->entries));
+	for (unsigned n = 0; n < count; n++)
+		table->offsets[decode_table_key(candidates[n], table->bits, table->num_bits) + 1]++;
+	for (unsigned i = 0; i < buckets; i++)
+		table->offsets[i + 1] += table->offsets[i] + 1;
+	unsigned *fill = calloc(buckets, sizeof(unsigned));
+	for (unsigned n = 0; n < count; n++) {
+		unsigned key = decode_table_key(candidates[n], table->bits, table->num_bits);
+		table->entries[table->offsets[key] + fill[key]++] = candidates[n];
+	}
+	free(fill);
+	free(candidates);
 
-		BITSET_COPY(not_dontcare.bitset, bitsets[n]->dontcare.bitset);
-		BITSET_NOT(not_dontcare.bitset);
+	return table;
+}
 
-		BITSET_AND(m.bitset, m.bitset, not_dontcare.bitset);
+static const struct isa_bitset **
+decode_table_lookup(const struct isa_bitset **bitsets, unsigned gpu_id, bitmask_t val)
+{
+	unsigned slot = (((uintptr_t)bitsets >> 3) ^ gpu_id) % ARRAY_SIZE(decode_tables);
+	struct decode_table *head = atomic_load_explicit(&decode_tables[slot], memory_order_acquire);
+	struct decode_table *table = head;
+	while (table && (table->bitsets != bitsets || table->gpu_id != gpu_id))
+		table = table->next;
+	if (!table) {
+		table = decode_table_build(bitsets, gpu_id);
+		do {
+			table->next = head;
+		} while (!atomic_compare_exchange_weak_explicit(&decode_tables[slot], &head, table,
+				memory_order_release, memory_order_acquire));
+	}
+
+	unsigned key = 0;
+	for (unsigned i = 0; i < table->num_bits; i++)
+		key = (key << 1) | BITSET_TEST(val.bitset, table->bits[i]);
+	return table->entries + table->offsets[key];
+}
 
-		if (!BITSET_EQUAL(m.bitset, bitsets[n]->match.bitset)) {
+/**
+ * Find the bitset in NULL terminated bitset hiearchy root table which
+ * matches against 'val'
+ */
+static const struct isa_bitset *
+find_bitset(struct decode_state *state, const struct isa_bitset **bitsets,
+		bitmask_t val)
+{
+	const struct isa_bitset *match = NULL;
+	bitsets = decode_table_lookup(bitsets, state->options->gpu_id, val);
+	for (int n = 0; bitsets[n]; n++) {
+		if (!bitmask_match(val, bitsets[n])) {
 			continue;
 		}
 
@@ -321,10 +522,9 @@ find_bitset(struct decode_state *state, const struct isa_bitset **bitsets,
 	}
 
 	if (match) {
-		bitmask_t m = { 0 };
-		BITSET_AND(m.bitset, match->dontcare.bitset, val.bitset);
+		bitmask_t m = bitmask_and(match->dontcare, val);
 
-		if (BITSET_COUNT(m.bitset)) {
+		if (!bitmask_empty(m)) {
 			decode_error(state, "dontcare bits in %s: %"BITSET_FORMAT,
 					match->name, BITSET_VALUE(m.bitset));
 		}
@@ -376,16 +576,7 @@ find_field(struct decode_scope *scope, const struct isa_bitset *bitset,
 static bitmask_t
 extract_field(struct decode_scope *scope, const struct isa_field *field)
 {
-   bitmask_t val, mask;
-
-   BITSET_COPY(val.bitset, scope->val.bitset);
-   BITSET_ZERO(mask.bitset);
-
-   BITSET_SET_RANGE(mask.bitset, field->low, field->high);
-   BITSET_AND(val.bitset, val.bitset, mask.bitset);
-   BITSET_SHR(val.bitset, field->low);
-
-   return val;
+   return bitmask_extract(scope->val, field->low, field->high);
 }
 
 /**
@@ -408,7 +599,7 @@ find_display(struct decode_scope *scope, const struct isa_bitset *bitset)
 				bitmask_t val;
 
 				val = extract_field(scope, f);
-				if (!BITSET_EQUAL(val.bitset, f->val.bitset)) {
+				if (!bitmask_equal(val, f->val)) {
 					decode_error(scope->state, "WARNING: unexpected "
 							"bits[%u:%u] in %s: %"BITSET_FORMAT" vs %"BITSET_FORMAT,
 							f->low, f->high, bitset->name,
@@ -710,8 +901,15 @@ display(struct decode_scope *scope)
 
 			p = e;
 		} else {
-			fputc(*p, scope->state->print.out);
-			scope->state->print.line_column++;
+			const char *e = p;
+			while (e[1] != '\0' && e[1] != '{') {
+				e++;
+			}
+
+			fwrite(p, 1, e-p+1, scope->state->print.out);
+			scope->state->print.line_column += e-p+1;
+
+			p = e;
 		}
 		p++;
 	}
@@ -954,7 +1152,7 @@ isa_disasm(void *bin, int sz, FILE *out, const struct isa_decode_options *option
 	if (!options)
 		options = &default_options;
 
-	state = rzalloc_size(NULL, sizeof(*state));
+	state = rzalloc_size(mesa_ralloc_context(out), sizeof(*state));
 	state->options = options;
 	state->num_instr = sz / (BITMASK_WORDS * sizeof(BITSET_WORD));
 
@@ -1000,15 +1198,16 @@ isa_disasm(void *bin, int sz, FILE *out, const struct isa_decode_options *option
 static bool
 isa_decode(void *out, void *bin, const struct isa_decode_options *options)
 {
-	struct decode_state *state = rzalloc_size(NULL, sizeof(*state));
+	FILE *context = mesa_context_create(NULL, 0);
+	struct decode_state *state = rzalloc_size(mesa_ralloc_context(context), sizeof(*state));
 	state->options = options;
 
 	bool result = decode(out, state, bin);
 
 	if (flush_errors(state)) {
-		return false;
+		result = false;
 	}
 
-	ralloc_free(state);
+	mesa_context_destroy(context);
 	return result;
 }
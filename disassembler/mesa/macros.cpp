@@ -1,89 +1,290 @@
 #include <stdlib.h>
-#include <unordered_map>
+#include <string.h>
+#include <algorithm>
+#include <string>
 #include <vector>
 #include "macros.h"
+#include "../../ShaderCompiler.h"
+#include "../../src/Sink.h"
+
+using ShaderCompiler::Instruction;
+static_assert(int(MESA_UNIT_SYNC) == int(Instruction::Sync));
+static_assert(int(MESA_FILE_SAMPLER) == int(Instruction::Sampler));
+
+// Per-disassembly arena behind the ralloc shims
+//
+// Every block starts with a header linking it to its ralloc parent, so
+// freeing a block frees its children as ralloc does. Freed blocks go to a
+// free list per power of two size class and are handed out again, memory
+// only comes from the system in chunks and all of it goes back at once when
+// the arena is destroyed.
+struct mesa_arena;
+
+struct mesa_block {
+   mesa_block* parent;
+   mesa_block* child;
+   mesa_block* prev;
+   mesa_block* next;
+   mesa_arena* arena;
+   size_t size_class;
+};
+
+struct mesa_chunk {
+   mesa_chunk* next;
+   size_t reserved;
+};
+
+struct mesa_arena {
+   static constexpr size_t FIRST_CHUNK = 64 * 1024;
+   static constexpr size_t LAST_CHUNK = 1024 * 1024;
+
+   mesa_chunk* chunks;
+   char* cursor;
+   char* end;
+   size_t chunk_size;
+   size_t allocated;
+   mesa_block* free_blocks[64];
+};
+
+static_assert(sizeof(mesa_block) % 16 == 0);
+static_assert(sizeof(mesa_chunk) % 16 == 0);
+
+// Context of one disassembly
+//
+// The FILE* handed to a Mesa disassembler is a mesa_context. It carries the
+// sink the text goes to, the debug flags of the disassembler and the arena
+// whose root block is the ralloc parent of everything the disassembler
+// allocates, nothing is shared between two contexts.
+struct mesa_context {
+   Sink* sink;
+   unsigned debug;
+   mesa_arena arena;
+   mesa_block root;
+};
+
+static Sink* mesa_sink(FILE* fp)
+{
+   return fp ? ((mesa_context*)fp)->sink : nullptr;
+}
+
+FILE* mesa_context_create(void* sink, unsigned debug)
+{
+   auto* context = (mesa_context*)calloc(1, sizeof(mesa_context));
+   context->sink = (Sink*)sink;
+   context->debug = debug;
+   context->arena.chunk_size = mesa_arena::FIRST_CHUNK;
+   context->root.arena = &context->arena;
+   return (FILE*)context;
+}
+
+void mesa_context_destroy(FILE* fp)
+{
+   auto* context = (mesa_context*)fp;
+   if (context == nullptr)
+      return;
+   for (mesa_chunk* chunk = context->arena.chunks; chunk; ) {
+      mesa_chunk* next = chunk->next;
+      free(chunk);
+      chunk = next;
+   }
+   free(context);
+}
+
+size_t mesa_allocated(FILE* fp)
+{
+   return fp ? sizeof(mesa_context) + ((mesa_context*)fp)->arena.allocated : 0;
+}
+
+unsigned mesa_debug(FILE* fp)
+{
+   return fp ? ((mesa_context*)fp)->debug : 0;
+}
+
+void* mesa_ralloc_context(FILE* fp)
+{
+   return fp ? &((mesa_context*)fp)->root + 1 : nullptr;
+}
 
 int mesa_fprintf(FILE* fp, const char* format, ...)
 {
    va_list args;
    va_start(args, format);
-   char temp[256];
-   int ret = vsnprintf(temp, 256, format, args);
-   va_end(args);
-
-   if (fp) {
-      auto& string = *(std::string*)fp;
-      string += temp;
+   int ret;
+   if (Sink* sink = mesa_sink(fp)) {
+      ret = sink->PrintV(format, args);
+   } else {
+      ret = vsnprintf(nullptr, 0, format, args);
    }
+   va_end(args);
    return ret;
 }
 
 int mesa_fputs(const char* str, FILE* fp)
 {
-   if (fp) {
-      auto& string = *(std::string*)fp;
-      string += str;
+   if (Sink* sink = mesa_sink(fp)) {
+      sink->Write(str);
    }
    return 0;
 }
 
-int mesa_fputc(char c, FILE* fp)
+int mesa_fputc(int c, FILE* fp)
 {
-   if (fp) {
-      auto& string = *(std::string*)fp;
-      string += c;
+   if (Sink* sink = mesa_sink(fp)) {
+      char temp = (char)c;
+      sink->Write(&temp, 1);
    }
-   return 0;
+   return c;
 }
 
-static std::vector<void*> allocated_pool;
-
-void* ralloc_size(void*, size_t size)
+size_t mesa_fwrite(const void* ptr, size_t size, size_t count, FILE* fp)
 {
-   allocated_pool.emplace_back(malloc(size));
-   return allocated_pool.back();
+   if (Sink* sink = mesa_sink(fp)) {
+      sink->Write((const char*)ptr, size * count);
+   }
+   return count;
 }
 
-void* rzalloc_size(void*, size_t size)
+void mesa_instruction(FILE* fp, uint32_t offset, uint32_t size, const char* opcode, enum mesa_unit unit, const uint32_t* operands, unsigned count)
 {
-   allocated_pool.emplace_back(calloc(1, size));
-   return allocated_pool.back();
+   if (Sink* sink = mesa_sink(fp)) {
+      sink->Record(offset, size, opcode, unit, operands, count);
+   }
 }
 
-void ralloc_free(void* pointer)
+static mesa_block* mesa_arena_block(mesa_arena* arena, size_t size)
 {
-   for (auto& allocated : allocated_pool) {
-      if (allocated == pointer) {
-         std::swap(allocated, allocated_pool.back());
-         allocated_pool.pop_back();
-         free(pointer);
-         break;
+   size_t size_class = 5;
+   while ((size_t(1) << size_class) < size + sizeof(mesa_block))
+      size_class++;
+
+   mesa_block* block = arena->free_blocks[size_class];
+   if (block) {
+      arena->free_blocks[size_class] = block->next;
+   } else {
+      size_t block_size = size_t(1) << size_class;
+      if (size_t(arena->end - arena->cursor) < block_size) {
+         size_t chunk_size = std::max(arena->chunk_size, block_size + sizeof(mesa_chunk));
+         auto* chunk = (mesa_chunk*)malloc(chunk_size);
+         chunk->next = arena->chunks;
+         arena->allocated += chunk_size;
+         arena->chunks = chunk;
+         arena->cursor = (char*)(chunk + 1);
+         arena->end = (char*)chunk + chunk_size;
+         arena->chunk_size = std::min(arena->chunk_size * 2, mesa_arena::LAST_CHUNK);
       }
+      block = (mesa_block*)arena->cursor;
+      arena->cursor += block_size;
    }
+   block->arena = arena;
+   block->size_class = size_class;
+   return block;
 }
 
-static std::vector<std::unordered_map<void*, hash_entry>*> hash_table_pool;
+static void mesa_arena_release(mesa_block* block)
+{
+   while (block->child) {
+      mesa_block* child = block->child;
+      block->child = child->next;
+      mesa_arena_release(child);
+   }
+   mesa_arena* arena = block->arena;
+   block->next = arena->free_blocks[block->size_class];
+   arena->free_blocks[block->size_class] = block;
+}
+
+void* ralloc_size(void* parent, size_t size)
+{
+   // Allocations without a context have no arena to come from
+   if (parent == nullptr)
+      abort();
+   mesa_block* owner = (mesa_block*)parent - 1;
+   mesa_block* block = mesa_arena_block(owner->arena, size);
+   block->parent = owner;
+   block->child = nullptr;
+   block->prev = nullptr;
+   block->next = owner->child;
+   if (block->next)
+      block->next->prev = block;
+   owner->child = block;
+   return block + 1;
+}
 
-struct hash_table *_mesa_pointer_hash_table_create(void*)
+void* rzalloc_size(void* parent, size_t size)
 {
-   auto* map = new std::unordered_map<void*, hash_entry>;
-   hash_table_pool.emplace_back(map);
-   return (struct hash_table *)map;
+   void* pointer = ralloc_size(parent, size);
+   memset(pointer, 0, size);
+   return pointer;
 }
 
-struct hash_entry *_mesa_hash_table_search(void* table, void* key)
+void ralloc_free(void* pointer)
 {
-   auto& map = *(std::unordered_map<void*, hash_entry>*)table;
-   auto it = map.find(key);
-   if (it != map.end())
-      return &(*it).second;
-   return nullptr;
+   if (pointer == nullptr)
+      return;
+   mesa_block* block = (mesa_block*)pointer - 1;
+   if (block->prev)
+      block->prev->next = block->next;
+   else if (block->parent)
+      block->parent->child = block->next;
+   if (block->next)
+      block->next->prev = block->prev;
+   mesa_arena_release(block);
 }
 
-void _mesa_hash_table_insert(void* table, void* key, void* value)
+// Open addressing pointer map, allocated as a child of its ralloc parent
+struct hash_table {
+   struct slot {
+      void* key;
+      hash_entry entry;
+   };
+   slot* slots;
+   uint32_t capacity;
+   uint32_t count;
+};
+
+static hash_table::slot* mesa_hash_table_slot(hash_table* table, void* key)
 {
-   auto& map = *(std::unordered_map<void*, hash_entry>*)table;
-   map[key] = hash_entry{ value };
+   uint32_t mask = table->capacity - 1;
+   uint32_t index = uint32_t((uintptr_t(key) * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+   while (table->slots[index].key && table->slots[index].key != key)
+      index = (index + 1) & mask;
+   return &table->slots[index];
+}
+
+struct hash_table *_mesa_pointer_hash_table_create(void* parent)
+{
+   auto* table = (hash_table*)ralloc_size(parent, sizeof(hash_table));
+   table->capacity = 8;
+   table->count = 0;
+   table->slots = (hash_table::slot*)rzalloc_size(table, sizeof(hash_table::slot) * table->capacity);
+   return table;
+}
+
+struct hash_entry *_mesa_hash_table_search(void* pointer, void* key)
+{
+   auto* slot = mesa_hash_table_slot((hash_table*)pointer, key);
+   return slot->key ? &slot->entry : nullptr;
+}
+
+void _mesa_hash_table_insert(void* pointer, void* key, void* value)
+{
+   auto* table = (hash_table*)pointer;
+   if ((table->count + 1) * 4 > table->capacity * 3) {
+      auto* slots = table->slots;
+      uint32_t capacity = table->capacity;
+      table->capacity = capacity * 2;
+      table->slots = (hash_table::slot*)rzalloc_size(table, sizeof(hash_table::slot) * table->capacity);
+      for (uint32_t i = 0; i < capacity; ++i) {
+         if (slots[i].key)
+            *mesa_hash_table_slot(table, slots[i].key) = slots[i];
+      }
+      ralloc_free(slots);
+   }
+   auto* slot = mesa_hash_table_slot(table, key);
+   if (slot->key == nullptr) {
+      slot->key = key;
+      table->count++;
+   }
+   slot->entry.data = value;
 }
 
 union fi {
@@ -124,15 +325,3 @@ _mesa_half_to_float(uint16_t val)
 
    return f32.f;
 }
-
-void mesa_cleanup()
-{
-   for (auto* pointer : allocated_pool) {
-      free(pointer);
-   }
-   allocated_pool.clear();
-   for (auto* map : hash_table_pool) {
-      delete map;
-   }
-   hash_table_pool.clear();
-}
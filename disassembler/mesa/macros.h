@@ -20,6 +20,7 @@
 #define fprintf mesa_fprintf
 #define fputs mesa_fputs
 #define fputc mesa_fputc
+#define fwrite mesa_fwrite
 #define mesa_loge(...)
 #define uif(v) (*(float*)&v)
 #define util_bitcount __builtin_popcount
@@ -42,7 +43,38 @@ extern "C" {
 
 int mesa_fprintf(FILE* fp, const char* format, ...);
 int mesa_fputs(const char* str, FILE* fp);
-int mesa_fputc(char c, FILE* fp);
+int mesa_fputc(int c, FILE* fp);
+size_t mesa_fwrite(const void* ptr, size_t size, size_t count, FILE* fp);
+
+enum mesa_unit {
+   MESA_UNIT_NONE,
+   MESA_UNIT_ALU,
+   MESA_UNIT_SPECIAL,
+   MESA_UNIT_FLOW,
+   MESA_UNIT_MEMORY,
+   MESA_UNIT_TEXTURE,
+   MESA_UNIT_VARYING,
+   MESA_UNIT_SYNC,
+};
+
+enum mesa_file {
+   MESA_FILE_REGISTER = 1,
+   MESA_FILE_CONSTANT,
+   MESA_FILE_UNIFORM,
+   MESA_FILE_PREDICATE,
+   MESA_FILE_INPUT,
+   MESA_FILE_OUTPUT,
+   MESA_FILE_SAMPLER,
+};
+
+#define MESA_OPERAND(file, index) (((uint32_t)(file) << 24) | ((uint32_t)(index) & 0xFFFFFF))
+void mesa_instruction(FILE* fp, uint32_t offset, uint32_t size, const char* opcode, enum mesa_unit unit, const uint32_t* operands, unsigned count);
+
+FILE* mesa_context_create(void* sink, unsigned debug);
+void mesa_context_destroy(FILE* fp);
+size_t mesa_allocated(FILE* fp);
+unsigned mesa_debug(FILE* fp);
+void* mesa_ralloc_context(FILE* fp);
 
 #define ralloc_array(p, s, c) ralloc_size(p, sizeof(s) * c)
 void* ralloc_size(void*, size_t size);
@@ -56,8 +88,6 @@ void _mesa_hash_table_insert(void* table, void* key, void* value);
 
 float _mesa_half_to_float(uint16_t val);
 
-void mesa_cleanup();
-
 #ifdef __cplusplus
 };
 #endif
@@ -56,6 +56,7 @@ typedef enum {
 
 typedef struct {
    unsigned *midg_tags;
+   unsigned num_words;
 
    /* For static analysis to ensure all registers are written at least once
     * before use along the source code path (TODO: does this break done for
@@ -63,8 +64,28 @@ typedef struct {
     */
 
    uint16_t midg_ever_written;
+
+   /* Byte offset and size of the bundle being printed, for the
+    * instruction records */
+   unsigned offset;
+   unsigned size;
 } disassemble_context;
 
+static void
+record_instr(disassemble_context *ctx, FILE *fp, const char *opcode,
+             enum mesa_unit unit, const uint32_t *operands, unsigned count)
+{
+   mesa_instruction(fp, ctx->offset, ctx->size, opcode, unit, operands, count);
+}
+
+static uint32_t
+record_alu_src(unsigned reg)
+{
+   if (reg == REGISTER_CONSTANT)
+      return MESA_OPERAND(MESA_FILE_CONSTANT, 0);
+   return MESA_OPERAND(MESA_FILE_REGISTER, reg);
+}
+
 /* Transform an expanded writemask (duplicated 8-bit format) into its condensed
  * form (one bit per component) */
 
@@ -786,6 +807,15 @@ print_vector_field(disassemble_context *ctx, FILE *fp, const char *name,
    bool is_int = midgard_is_integer_op(op);
    bool is_int_out = midgard_is_integer_out_op(op);
 
+   uint32_t operands[3] = {
+      MESA_OPERAND(MESA_FILE_REGISTER, reg_info->out_reg),
+      record_alu_src(reg_info->src1_reg),
+      record_alu_src(reg_info->src2_reg),
+   };
+   record_instr(ctx, fp, alu_opcode_props[op].name,
+                strcmp(name, "lut") ? MESA_UNIT_ALU : MESA_UNIT_SPECIAL,
+                operands, reg_info->src2_imm ? 2 : 3);
+
    if (verbose)
       fprintf(fp, "%s.", name);
 
@@ -908,6 +938,14 @@ print_scalar_field(disassemble_context *ctx, FILE *fp, const char *name,
    if (alu_field->reserved)
       fprintf(fp, "scalar ALU reserved bit set\n");
 
+   uint32_t operands[3] = {
+      MESA_OPERAND(MESA_FILE_REGISTER, reg_info->out_reg),
+      record_alu_src(reg_info->src1_reg),
+      record_alu_src(reg_info->src2_reg),
+   };
+   record_instr(ctx, fp, alu_opcode_props[alu_field->op].name, MESA_UNIT_ALU,
+                operands, reg_info->src2_imm ? 2 : 3);
+
    if (verbose)
       fprintf(fp, "%s.", name);
 
@@ -1028,6 +1066,9 @@ print_compact_branch_writeout_field(disassemble_context *ctx, FILE *fp,
 {
    midgard_jmp_writeout_op op = word & 0x7;
 
+   record_instr(ctx, fp, op == midgard_jmp_writeout_op_writeout ? "writeout" : "br",
+                MESA_UNIT_FLOW, NULL, 0);
+
    switch (op) {
    case midgard_jmp_writeout_op_branch_uncond: {
       midgard_branch_uncond br_uncond;
@@ -1079,6 +1120,8 @@ print_extended_branch_writeout_field(disassemble_context *ctx, FILE *fp,
    midgard_branch_extended br;
    memcpy((char *)&br, (char *)words, sizeof(br));
 
+   record_instr(ctx, fp, "brx", MESA_UNIT_FLOW, NULL, 0);
+
    fprintf(fp, "brx%s.", function_call_mode(br.call_mode));
 
    print_branch_op(fp, br.op);
@@ -1106,13 +1149,16 @@ print_extended_branch_writeout_field(disassemble_context *ctx, FILE *fp,
 
    unsigned I = next + br.offset * 4;
 
-   if (ctx->midg_tags[I] && ctx->midg_tags[I] != br.dest_tag) {
-      fprintf(fp, "\t/* XXX TAG ERROR: jumping to %s but tagged %s \n",
-              midgard_tag_props[br.dest_tag].name,
-              midgard_tag_props[ctx->midg_tags[I]].name);
-   }
+   /* Targets outside of the shader are not tracked */
+   if (I < ctx->num_words) {
+      if (ctx->midg_tags[I] && ctx->midg_tags[I] != br.dest_tag) {
+         fprintf(fp, "\t/* XXX TAG ERROR: jumping to %s but tagged %s \n",
+                 midgard_tag_props[br.dest_tag].name,
+                 midgard_tag_props[ctx->midg_tags[I]].name);
+      }
 
-   ctx->midg_tags[I] = br.dest_tag;
+      ctx->midg_tags[I] = br.dest_tag;
+   }
 
    return br.offset >= 0;
 }
@@ -1298,6 +1344,12 @@ print_load_store_instr(disassemble_context *ctx, FILE *fp, uint64_t data,
                        bool verbose)
 {
    midgard_load_store_word *word = (midgard_load_store_word *)&data;
+   const char *opcode = load_store_opcode_props[word->op].name;
+   uint32_t operand = MESA_OPERAND(MESA_FILE_REGISTER, word->reg);
+
+   record_instr(ctx, fp, opcode,
+                (opcode && strstr(opcode, "vary")) ? MESA_UNIT_VARYING : MESA_UNIT_MEMORY,
+                &operand, word->op == midgard_op_trap ? 0 : 1);
 
    print_ld_st_opcode(fp, word->op);
 
@@ -1654,6 +1706,15 @@ print_texture_word(disassemble_context *ctx, FILE *fp, const uint32_t *word,
    midgard_texture_word *texture = (midgard_texture_word *)word;
    validate_sampler_type(texture->op, texture->sampler_type);
 
+   uint32_t operands[2] = {
+      MESA_OPERAND(MESA_FILE_REGISTER, out_reg_base + texture->out_reg_select),
+      MESA_OPERAND(MESA_FILE_REGISTER, in_reg_base + texture->in_reg_select),
+   };
+   bool barrier = texture->op == midgard_tex_op_barrier;
+   record_instr(ctx, fp, tex_opcode_props[texture->op].name,
+                barrier ? MESA_UNIT_SYNC : MESA_UNIT_TEXTURE, operands,
+                barrier ? 0 : 2);
+
    /* Broad category of texture operation in question */
    print_texture_op(fp, texture->op);
 
@@ -1833,6 +1894,7 @@ disassemble_midgard(FILE *fp, const void *code, size_t size, unsigned gpu_id,
 
    disassemble_context ctx = {
       .midg_tags = calloc(sizeof(ctx.midg_tags[0]), num_words),
+      .num_words = num_words,
       .midg_ever_written = 0,
    };
 
@@ -1848,6 +1910,8 @@ disassemble_midgard(FILE *fp, const void *code, size_t size, unsigned gpu_id,
       }
 
       ctx.midg_tags[i] = tag;
+      ctx.offset = i * 4;
+      ctx.size = num_quad_words * 16;
 
       /* Check the tag. The idea is to ensure that next_tag is
        * *always* recoverable from the disassembly, such that we may
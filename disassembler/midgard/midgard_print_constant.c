@@ -78,7 +78,7 @@ mir_print_constant_component(FILE *fp, const midgard_constants *consts,
          if (mod & MIDGARD_FLOAT_MOD_NEG)
             v = -v;
 
-         printf("%g", v);
+         fprintf(fp, "%g", v);
       }
       break;
 
@@ -162,5 +162,6 @@ typedef struct __attribute__((__packed__)) {
 } gpir_codegen_instr;
 
 void gpir_disassemble_program(gpir_codegen_instr *code, unsigned num_instr, FILE *fp);
+void gpir_disassemble_range(gpir_codegen_instr *code, unsigned begin, unsigned end, FILE *fp);
 
 #endif
@@ -47,6 +47,15 @@ static const gpir_codegen_store_src gp_unit_to_store_src[num_units] = {
    [unit_complex] = gpir_codegen_store_src_complex,
 };
 
+static void
+record_op(FILE *fp, const char *opcode, gp_unit unit, enum mesa_unit kind,
+          unsigned cur_dest_index)
+{
+   uint32_t operand = MESA_OPERAND(MESA_FILE_REGISTER, cur_dest_index + unit);
+   mesa_instruction(fp, cur_dest_index / num_units * sizeof(gpir_codegen_instr),
+                    sizeof(gpir_codegen_instr), opcode, kind, &operand, 1);
+}
+
 static void
 print_dest(gpir_codegen_instr *instr, gp_unit unit, unsigned cur_dest_index, FILE *fp)
 {
@@ -260,6 +269,7 @@ print_mul(gpir_codegen_instr *instr, gpir_codegen_instr *prev_instr,
          if (instr->mul0_src1 == gpir_codegen_src_ident &&
              !instr->mul0_neg) {
             fprintf(fp, "mov.m0 ");
+            record_op(fp, "mov", unit_mul_0, MESA_UNIT_ALU, cur_dest_index);
             print_dest(instr, unit_mul_0, cur_dest_index, fp);
             fprintf(fp, " ");
             print_src(instr->mul0_src0, unit_mul_0, 0, instr, prev_instr,
@@ -269,6 +279,9 @@ print_mul(gpir_codegen_instr *instr, gpir_codegen_instr *prev_instr,
                fprintf(fp, "complex2.m0 ");
             else
                fprintf(fp, "mul.m0 ");
+            record_op(fp, instr->mul_op == gpir_codegen_mul_op_complex2 ?
+                      "complex2" : "mul", unit_mul_0, MESA_UNIT_ALU,
+                      cur_dest_index);
 
             print_dest(instr, unit_mul_0, cur_dest_index, fp);
             fprintf(fp, " ");
@@ -291,12 +304,14 @@ print_mul(gpir_codegen_instr *instr, gpir_codegen_instr *prev_instr,
          if (instr->mul1_src1 == gpir_codegen_src_ident &&
              !instr->mul1_neg) {
             fprintf(fp, "mov.m1 ");
+            record_op(fp, "mov", unit_mul_1, MESA_UNIT_ALU, cur_dest_index);
             print_dest(instr, unit_mul_1, cur_dest_index, fp);
             fprintf(fp, " ");
             print_src(instr->mul1_src0, unit_mul_1, 0, instr, prev_instr,
                       cur_dest_index, fp);
          } else {
             fprintf(fp, "mul.m1 ");
+            record_op(fp, "mul", unit_mul_1, MESA_UNIT_ALU, cur_dest_index);
             print_dest(instr, unit_mul_1, cur_dest_index, fp);
             fprintf(fp, " ");
             print_src(instr->mul1_src0, unit_mul_1, 0, instr, prev_instr,
@@ -314,6 +329,7 @@ print_mul(gpir_codegen_instr *instr, gpir_codegen_instr *prev_instr,
    case gpir_codegen_mul_op_complex1:
       printed = true;
       fprintf(fp, "\tcomplex1.m01 ");
+      record_op(fp, "complex1", unit_mul_0, MESA_UNIT_ALU, cur_dest_index);
       print_dest(instr, unit_mul_0, cur_dest_index, fp);
       fprintf(fp, " ");
       print_src(instr->mul0_src0, unit_mul_0, 0, instr, prev_instr,
@@ -333,6 +349,7 @@ print_mul(gpir_codegen_instr *instr, gpir_codegen_instr *prev_instr,
    case gpir_codegen_mul_op_select:
       printed = true;
       fprintf(fp, "\tsel.m01 ");
+      record_op(fp, "sel", unit_mul_0, MESA_UNIT_ALU, cur_dest_index);
       print_dest(instr, unit_mul_0, cur_dest_index, fp);
       fprintf(fp, " ");
       print_src(instr->mul0_src1, unit_mul_0, 1, instr, prev_instr,
@@ -349,6 +366,7 @@ print_mul(gpir_codegen_instr *instr, gpir_codegen_instr *prev_instr,
    default:
       printed = true;
       fprintf(fp, "\tunknown%u.m01 ", instr->mul_op);
+      record_op(fp, NULL, unit_mul_0, MESA_UNIT_ALU, cur_dest_index);
       print_dest(instr, unit_mul_0, cur_dest_index, fp);
       fprintf(fp, " ");
       print_src(instr->mul0_src0, unit_mul_0, 0, instr, prev_instr,
@@ -414,6 +432,7 @@ print_acc(gpir_codegen_instr *instr, gpir_codegen_instr *prev_instr,
          fprintf(fp, "%s.a0 ", acc0_op.name);
       else
          fprintf(fp, "op%u.a0 ", instr->acc_op);
+      record_op(fp, acc0_op.name, unit_acc_0, MESA_UNIT_ALU, cur_dest_index);
 
       print_dest(instr, unit_acc_0, cur_dest_index, fp);
       fprintf(fp, " ");
@@ -447,6 +466,7 @@ print_acc(gpir_codegen_instr *instr, gpir_codegen_instr *prev_instr,
          fprintf(fp, "%s.a1 ", acc1_op.name);
       else
          fprintf(fp, "op%u.a1 ", instr->acc_op);
+      record_op(fp, acc1_op.name, unit_acc_1, MESA_UNIT_ALU, cur_dest_index);
 
       print_dest(instr, unit_acc_1, cur_dest_index, fp);
       fprintf(fp, " ");
@@ -477,22 +497,28 @@ print_pass(gpir_codegen_instr *instr, gpir_codegen_instr *prev_instr,
 
    fprintf(fp, "\t");
 
+   const char *name = NULL;
    switch (instr->pass_op) {
    case gpir_codegen_pass_op_pass:
       fprintf(fp, "mov.p ");
+      name = "mov";
       break;
    case gpir_codegen_pass_op_preexp2:
       fprintf(fp, "preexp2.p ");
+      name = "preexp2";
       break;
    case gpir_codegen_pass_op_postlog2:
       fprintf(fp, "postlog2.p ");
+      name = "postlog2";
       break;
    case gpir_codegen_pass_op_clamp:
       fprintf(fp, "clamp.p ");
+      name = "clamp";
       break;
    default:
       fprintf(fp, "unk%u.p ", instr->pass_op);
    }
+   record_op(fp, name, unit_pass, MESA_UNIT_ALU, cur_dest_index);
 
    print_dest(instr, unit_pass, cur_dest_index, fp);
    fprintf(fp, " ");
@@ -528,15 +554,19 @@ print_complex(gpir_codegen_instr *instr, gpir_codegen_instr *prev_instr,
 
    case gpir_codegen_complex_op_exp2:
       fprintf(fp, "exp2.c ");
+      record_op(fp, "exp2", unit_complex, MESA_UNIT_SPECIAL, cur_dest_index);
       break;
    case gpir_codegen_complex_op_log2:
       fprintf(fp, "log2.c ");
+      record_op(fp, "log2", unit_complex, MESA_UNIT_SPECIAL, cur_dest_index);
       break;
    case gpir_codegen_complex_op_rsqrt:
       fprintf(fp, "rsqrt.c ");
+      record_op(fp, "rsqrt", unit_complex, MESA_UNIT_SPECIAL, cur_dest_index);
       break;
    case gpir_codegen_complex_op_rcp:
       fprintf(fp, "rcp.c ");
+      record_op(fp, "rcp", unit_complex, MESA_UNIT_SPECIAL, cur_dest_index);
       break;
    case gpir_codegen_complex_op_pass:
    case gpir_codegen_complex_op_temp_store_addr:
@@ -544,9 +574,11 @@ print_complex(gpir_codegen_instr *instr, gpir_codegen_instr *prev_instr,
    case gpir_codegen_complex_op_temp_load_addr_1:
    case gpir_codegen_complex_op_temp_load_addr_2:
       fprintf(fp, "mov.c ");
+      record_op(fp, "mov", unit_complex, MESA_UNIT_ALU, cur_dest_index);
       break;
    default:
       fprintf(fp, "unk%u.c ", instr->complex_op);
+      record_op(fp, NULL, unit_complex, MESA_UNIT_SPECIAL, cur_dest_index);
    }
 
    print_dest(instr, unit_complex, cur_dest_index, fp);
@@ -572,6 +604,7 @@ print_instr(gpir_codegen_instr *instr, gpir_codegen_instr *prev_instr,
    if (instr->branch) {
       printed = true;
       /* The branch condition is taken from the current pass unit result */
+      record_op(fp, "branch", unit_pass, MESA_UNIT_FLOW, cur_dest_index);
       fprintf(fp, "\tbranch ^%d %03d\n", cur_dest_index + unit_pass,
              instr->branch_target + (instr->branch_target_lo ? 0 : 0x100));
    }
@@ -588,9 +621,18 @@ print_instr(gpir_codegen_instr *instr, gpir_codegen_instr *prev_instr,
 void
 gpir_disassemble_program(gpir_codegen_instr *code, unsigned num_instr, FILE *fp)
 {
-   unsigned cur_dest_index = 0;
-   unsigned cur_instr = 0;
-   for (gpir_codegen_instr *instr = code; cur_instr < num_instr;
+   gpir_disassemble_range(code, 0, num_instr, fp);
+}
+
+/* Instructions only look back at the previous one, so any range can be
+ * printed on its own and gives the same text as the whole program does. */
+void
+gpir_disassemble_range(gpir_codegen_instr *code, unsigned begin, unsigned end,
+                       FILE *fp)
+{
+   unsigned cur_dest_index = begin * num_units;
+   unsigned cur_instr = begin;
+   for (gpir_codegen_instr *instr = code + begin; cur_instr < end;
         instr++, cur_instr++, cur_dest_index += num_units) {
       print_instr(instr, instr - 1, cur_instr, cur_dest_index, fp);
    }
@@ -598,7 +598,8 @@ print_float_acc(void *code, unsigned offset, FILE *fp)
    .srcs = _srcs \
 }
 
-static const asm_op combine_ops[] = {
+/* sized to the whole op field, unused ops print as op%u */
+static const asm_op combine_ops[16] = {
    CASE(rcp, 1),
    CASE(mov, 1),
    CASE(sqrt, 1),
@@ -808,6 +809,61 @@ static const int ppir_codegen_field_size[] = {
    34, 62, 41, 43, 30, 44, 31, 30, 41, 73, 64, 64
 };
 
+static const char *ppir_codegen_field_name[] = {
+   "varying", "sampler", "uniform", "vec4_mul", "float_mul", "vec4_acc",
+   "float_acc", "combine", "temp_write", "branch", "const0", "const1"
+};
+
+static const enum mesa_unit ppir_codegen_field_unit[] = {
+   MESA_UNIT_VARYING, MESA_UNIT_TEXTURE, MESA_UNIT_MEMORY, MESA_UNIT_ALU,
+   MESA_UNIT_ALU, MESA_UNIT_ALU, MESA_UNIT_ALU, MESA_UNIT_SPECIAL,
+   MESA_UNIT_MEMORY, MESA_UNIT_FLOW, MESA_UNIT_NONE, MESA_UNIT_NONE
+};
+
+static void
+record_field(unsigned field, void *code, unsigned offset, unsigned size, FILE *fp)
+{
+   const char *opcode = ppir_codegen_field_name[field];
+   uint32_t operand = 0;
+   unsigned count = 0;
+
+   switch (field) {
+   case ppir_codegen_field_shift_vec4_mul: {
+      ppir_codegen_field_vec4_mul *vec4_mul = code;
+      opcode = vec4_mul_ops[vec4_mul->op].name;
+      operand = MESA_OPERAND(MESA_FILE_REGISTER, vec4_mul->dest * 4);
+      count = vec4_mul->mask ? 1 : 0;
+      break;
+   }
+   case ppir_codegen_field_shift_vec4_acc: {
+      ppir_codegen_field_vec4_acc *vec4_acc = code;
+      opcode = vec4_acc_ops[vec4_acc->op].name;
+      operand = MESA_OPERAND(MESA_FILE_REGISTER, vec4_acc->dest * 4);
+      count = vec4_acc->mask ? 1 : 0;
+      break;
+   }
+   case ppir_codegen_field_shift_float_mul: {
+      ppir_codegen_field_float_mul *float_mul = code;
+      opcode = float_mul_ops[float_mul->op].name;
+      operand = MESA_OPERAND(MESA_FILE_REGISTER, float_mul->dest);
+      count = float_mul->output_en ? 1 : 0;
+      break;
+   }
+   case ppir_codegen_field_shift_float_acc: {
+      ppir_codegen_field_float_acc *float_acc = code;
+      opcode = float_acc_ops[float_acc->op].name;
+      operand = MESA_OPERAND(MESA_FILE_REGISTER, float_acc->dest);
+      count = float_acc->output_en ? 1 : 0;
+      break;
+   }
+   default:
+      break;
+   }
+
+   mesa_instruction(fp, offset * 4, size * 4, opcode, ppir_codegen_field_unit[field],
+                    &operand, count);
+}
+
 static void
 bitcopy(unsigned char *src, unsigned char *dst, unsigned bits, unsigned src_offset)
 {
@@ -844,6 +900,7 @@ ppir_disassemble_instr(uint32_t *instr, unsigned offset, FILE *fp)
       else
          fprintf(fp, ", ");
 
+      record_field(i, code, offset, ctrl->count, fp);
       print_field[i](code, offset, fp);
 
       bit_offset += bits;
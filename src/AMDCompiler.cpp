@@ -1,6 +1,10 @@
 #include <string>
+#include <string_view>
+#include "Container.h"
 #include "Logger.h"
 #include "ShaderCompiler.h"
+#include "Sink.h"
+#include "Timeline.h"
 #include "VirtualMachine.h"
 #include "../mine/syscall/allocator.h"
 #include "../mine/x86/x86_i386.h"
@@ -9,34 +13,44 @@
 
 namespace AMDCompiler {
 
-struct Elf32_Ehdr {
-    uint8_t     e_ident[16];
-    uint16_t    e_type;
-    uint16_t    e_machine;
-    uint32_t    e_version;
-    uint32_t    e_entry;
-    uint32_t    e_phoff;
-    uint32_t    e_shoff;
-    uint32_t    e_flags;
-    uint16_t    e_ehsize;
-    uint16_t    e_phentsize;
-    uint16_t    e_phnum;
-    uint16_t    e_shentsize;
-    uint16_t    e_shnum;
-    uint16_t    e_shstrndx;
-};
+using ShaderCompiler::Instruction;
 
-struct Elf32_Shdr {
-    uint32_t    sh_name;
-    uint32_t    sh_type;
-    uint32_t    sh_flags;
-    uint32_t    sh_addr;
-    uint32_t    sh_offset;
-    uint32_t    sh_size;
-    uint32_t    sh_link;
-    uint32_t    sh_info;
-    uint32_t    sh_addralign;
-    uint32_t    sh_entsize;
+static const Sink::Syntax syntax = {
+    .comments = { "//", ";" },
+    .files = {
+        { "v", Instruction::Register },
+        { "s", Instruction::Uniform },
+        { "ttmp", Instruction::Uniform },
+    },
+    .units = {
+        { "s_branch", Instruction::Flow },
+        { "s_cbranch", Instruction::Flow },
+        { "s_endpgm", Instruction::Flow },
+        { "s_setpc", Instruction::Flow },
+        { "s_swappc", Instruction::Flow },
+        { "s_call", Instruction::Flow },
+        { "s_waitcnt", Instruction::Sync },
+        { "s_barrier", Instruction::Sync },
+        { "s_load", Instruction::Memory },
+        { "s_buffer", Instruction::Memory },
+        { "s_store", Instruction::Memory },
+        { "image_", Instruction::Texture },
+        { "buffer_", Instruction::Memory },
+        { "tbuffer_", Instruction::Memory },
+        { "global_", Instruction::Memory },
+        { "flat_", Instruction::Memory },
+        { "scratch_", Instruction::Memory },
+        { "ds_", Instruction::Memory },
+        { "exp", Instruction::Varying },
+        { "v_interp", Instruction::Varying },
+        { "v_rcp", Instruction::Special },
+        { "v_rsq", Instruction::Special },
+        { "v_sqrt", Instruction::Special },
+        { "v_log", Instruction::Special },
+        { "v_exp", Instruction::Special },
+        { "v_sin", Instruction::Special },
+        { "v_cos", Instruction::Special },
+    },
 };
 
 mine* NextProcess(mine* cpu)
@@ -52,12 +66,16 @@ mine* NextProcess(mine* cpu)
     switch (stack[4 + 0]) {
     case 'AMDH':
     case 'AMDI': {
+        Trace<TRACE_AMD>("%-12s : %08X", "AMDI", EAX);
+        Timeline::Scope scope("AMDCompiler::AMDI");
         auto* output = (char*)(memory + stack[4 + 1]);
         auto size = stack[4 + 2];
         if (size && (EAX == 0 || EAX == 1)) {
-            std::string& disasm = ShaderCompiler::outputs["Machine"].disasm;
-            disasm.assign(output, output + size);
-            disasm.resize(strlen(disasm.c_str()));
+            auto& machine = ShaderCompiler::outputs["Machine"];
+            Sink sink;
+            sink.Write(output, size);
+            sink.Flush(machine, &syntax);
+            ShaderCompiler::completed = true;
         }
         else {
             Logger<CONSOLE>("Compile : %08X\n", EAX);
@@ -65,30 +83,22 @@ mine* NextProcess(mine* cpu)
         break;
     }
     case 'AMDD': {
+        Trace<TRACE_AMD>("%-12s : %08X", "AMDD", EAX);
+        Timeline::Scope scope("AMDCompiler::AMDD");
         auto* output = (char*)(memory + stack[4 + 2]);
         auto size = stack[4 + 3];
         if (size && EAX == 0) {
             std::vector<char>& binary = ShaderCompiler::outputs["Machine"].binary;
             binary.assign(output, output + size);
 
-            uint32_t elf = 0;
-            memcpy(&elf, output, 4);
-            if (elf == 0x464C457F) {
-                auto& header = *(Elf32_Ehdr*)output;
-                auto* sections = (Elf32_Shdr*)(output + header.e_shoff);
-                const char* shstrtab = output + sections[header.e_shstrndx].sh_offset;
-                for (uint16_t i = 0; i < header.e_shnum; ++i) {
-                    if (strcmp(shstrtab + sections[i].sh_name, ".disassembly") == 0) {
-                        auto sh_offset = sections[i].sh_offset;
-                        auto sh_size = sections[i].sh_size;
-
-                        std::string& disasm = ShaderCompiler::outputs["Machine"].disasm;
-                        disasm.assign(output + sh_offset, output + sh_offset + sh_size);
-                        disasm.resize(strlen(disasm.c_str()));
-                        break;
-                    }
-                }
+            auto disassembly = Container::Find(Container::Span(output, size), Container::Format::ELF, ".disassembly");
+            if (disassembly) {
+                auto& machine = ShaderCompiler::outputs["Machine"];
+                Sink sink;
+                sink.Write((const char*)disassembly.data, disassembly.size);
+                sink.Flush(machine, &syntax);
             }
+            ShaderCompiler::completed = true;
         }
         else {
             Logger<CONSOLE>("Compile : %08X\n", EAX);
@@ -1,6 +1,7 @@
 #include <string>
 #include "Logger.h"
 #include "ShaderCompiler.h"
+#include "Timeline.h"
 #include "VirtualMachine.h"
 #include "../mine/syscall/allocator.h"
 #include "../mine/x86/x86_i386.h"
@@ -21,6 +22,8 @@ mine* NextProcess(mine* cpu)
 
     switch (stack[0]) {
     case 'R200': {
+        Trace<TRACE_ATI>("%-12s : %08X", "R200", EAX);
+        Timeline::Scope scope("ATICompiler::R200");
         auto binary = stack[1] ? (uint32_t*)(memory + stack[1]) : nullptr;
         auto binary_data_size = stack[2];
         if (binary) {
@@ -33,6 +36,9 @@ mine* NextProcess(mine* cpu)
         if (EAX != 0) {
             Logger<CONSOLE>("Compile : %08X\n", EAX);
         }
+        else if (binary) {
+            ShaderCompiler::completed = true;
+        }
         break;
     }
     default:
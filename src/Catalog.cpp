@@ -0,0 +1,501 @@
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#else
+#include <sys/event.h>
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "Catalog.h"
+#include "Logger.h"
+#include "ShaderCompiler.h"
+#include "UnifiedExecution.h"
+#include "VirtualMachine.h"
+
+namespace Catalog {
+
+using ShaderCompiler::Compiler;
+using ShaderCompiler::Driver;
+using ShaderCompiler::Machine;
+using ShaderCompiler::Parameter;
+
+static const uint32_t index_magic = 'SCIX';
+static const uint32_t index_version = 3;
+
+struct Image {
+    int64_t time;
+    std::string hash;
+};
+static std::map<std::string, Image> images;
+
+static int watch_fd = -1;
+#if !defined(__linux__)
+static std::vector<int> watch_fds;
+#endif
+
+static std::string ReadFile(const std::string& path)
+{
+    std::string context;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file) {
+        fseek(file, 0, SEEK_END);
+        context.resize(ftell(file));
+        fseek(file, 0, SEEK_SET);
+        context.resize(fread(context.data(), 1, context.size(), file));
+        fclose(file);
+    }
+    return context;
+}
+
+static std::vector<std::string> SplitLines(const std::string& context)
+{
+    std::vector<std::string> lines;
+    size_t begin = 0;
+    while (begin < context.size()) {
+        size_t end = context.find('\n', begin);
+        if (end == std::string::npos)
+            end = context.size();
+        size_t length = end - begin;
+        if (length && context[begin + length - 1] == '\r')
+            length--;
+        lines.emplace_back(context, begin, length);
+        begin = end + 1;
+    }
+    return lines;
+}
+
+static int64_t ModifiedTime(const std::string& path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return int64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+static std::string HashImage(const std::string& path)
+{
+    // Images are only hashed again when they were modified
+    int64_t time = ModifiedTime(path);
+    auto it = images.find(path);
+    if (it != images.end() && (*it).second.time == time)
+        return (*it).second.hash;
+    std::string hash = VirtualMachine::HashImage(path);
+    images[path] = { time, hash };
+    return hash;
+}
+
+void Parse(const std::string& compiler_path, const std::string& driver_path, std::vector<Compiler>& compilers, std::vector<Driver>& drivers, std::set<std::string>& dependencies)
+{
+    compilers.clear();
+    drivers.clear();
+    dependencies.clear();
+
+    // A DLL appearing or disappearing changes the modified time of its directory
+    auto directory = [](const std::string& path) {
+        return path.substr(0, path.find_last_of("/\\"));
+    };
+
+    if (compiler_path.empty() == false) {
+        for (auto& line : SplitLines(ReadFile(compiler_path + "/compiler.ini"))) {
+            if (line.empty())
+                continue;
+            Compiler compiler;
+            for (char c : line) {
+                if (c == '=') {
+                    compiler.name.swap(compiler.path);
+                    continue;
+                }
+                compiler.name.push_back(c);
+            }
+            compilers.push_back(compiler);
+        }
+        dependencies.insert(compiler_path);
+        dependencies.insert(compiler_path + "/compiler.ini");
+        for (auto& compiler : compilers) {
+            dependencies.insert(directory(compiler_path + "/" + compiler.path));
+        }
+
+        // Remove unavailable
+        struct stat st;
+        for (int64_t i = compilers.size() - 1; i >= 0; --i) {
+            auto path = compiler_path + "/" + compilers[i].path;
+            if (stat(path.c_str(), &st) != 0) {
+                compilers.erase(compilers.begin() + i);
+                continue;
+            }
+            compilers[i].hash = HashImage(path);
+        }
+    }
+
+    if (driver_path.empty() == false) {
+        auto finish = [&]() {
+            for (auto& driver : drivers) {
+                if (driver.machines.empty()) {
+                    driver.machines = drivers.back().machines;
+                }
+            }
+        };
+
+        for (auto& line : SplitLines(ReadFile(driver_path + "/driver.ini"))) {
+            switch (line.empty() ? 0 : line[0]) {
+            case 0:
+                break;
+            case '[':
+                finish();
+
+                drivers.push_back(Driver());
+                for (size_t i = 1; i < line.size(); ++i) {
+                    char c = line[i];
+                    if (c == ']')
+                        break;
+                    if (c == '=') {
+                        drivers.back().name.push_back(std::string());
+                        continue;
+                    }
+                    if (drivers.back().name.empty())
+                        drivers.back().name.push_back(std::string());
+                    drivers.back().name.back().push_back(c);
+                }
+                if (drivers.back().name.empty())
+                    drivers.pop_back();
+                break;
+            default:
+                bool quotation_mark = false;
+                std::vector<std::string> machine;
+                for (char c : line) {
+                    if ((c == '=' || c == ',') && quotation_mark == false) {
+                        machine.push_back(std::string());
+                        continue;
+                    }
+                    if (c == '\"') {
+                        quotation_mark = !quotation_mark;
+                    }
+                    if (machine.empty())
+                        machine.push_back(std::string());
+                    machine.back().push_back(c);
+                }
+                if (drivers.empty() == false && machine.empty() == false) {
+                    Machine compiled;
+                    if (UnifiedExecution::Compile(machine, compiled)) {
+                        drivers.back().machines.push_back(compiled);
+                    }
+                }
+                break;
+            }
+        }
+
+        finish();
+        dependencies.insert(driver_path);
+        dependencies.insert(driver_path + "/driver.ini");
+        for (auto& driver : drivers) {
+            dependencies.insert(directory(driver_path + "/" + driver.name.back()));
+        }
+
+        // Remove unavailable
+        struct stat st;
+        for (int64_t i = drivers.size() - 1; i >= 0; --i) {
+            auto path = driver_path + "/" + drivers[i].name.back();
+            if (stat(path.c_str(), &st) != 0) {
+                drivers.erase(drivers.begin() + i);
+                continue;
+            }
+            drivers[i].hash = HashImage(path);
+        }
+    }
+}
+
+struct Writer {
+    std::string data;
+    template<typename T>
+    void Value(T value) {
+        data.append((char*)&value, sizeof(T));
+    }
+    void String(const std::string& string) {
+        Value(uint32_t(string.size()));
+        data.append(string);
+    }
+};
+
+struct Reader {
+    const char* data;
+    const char* end;
+    bool failed = false;
+    template<typename T>
+    T Value() {
+        T value = {};
+        if (size_t(end - data) < sizeof(T)) {
+            failed = true;
+            return value;
+        }
+        memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return value;
+    }
+    std::string String() {
+        uint32_t size = Value<uint32_t>();
+        if (size_t(end - data) < size) {
+            failed = true;
+            return std::string();
+        }
+        std::string string(data, size);
+        data += size;
+        return string;
+    }
+};
+
+static void Save(const std::string& index_path, const std::vector<Compiler>& compilers, const std::vector<Driver>& drivers, const std::set<std::string>& dependencies)
+{
+    Writer writer;
+    writer.Value(index_magic);
+    writer.Value(index_version);
+
+    writer.Value(uint32_t(dependencies.size()));
+    for (auto& path : dependencies) {
+        writer.String(path);
+        writer.Value(ModifiedTime(path));
+    }
+
+    writer.Value(uint32_t(images.size()));
+    for (auto& [path, image] : images) {
+        writer.String(path);
+        writer.Value(image.time);
+        writer.String(image.hash);
+    }
+
+    writer.Value(uint32_t(compilers.size()));
+    for (auto& compiler : compilers) {
+        writer.String(compiler.name);
+        writer.String(compiler.path);
+        writer.String(compiler.hash);
+    }
+
+    writer.Value(uint32_t(drivers.size()));
+    for (auto& driver : drivers) {
+        writer.Value(uint32_t(driver.name.size()));
+        for (auto& name : driver.name) {
+            writer.String(name);
+        }
+        writer.String(driver.hash);
+        writer.Value(uint32_t(driver.machines.size()));
+        for (auto& machine : driver.machines) {
+            writer.String(machine.name);
+            writer.String(machine.entry);
+            writer.String(machine.strings);
+            writer.String(machine.key);
+            writer.Value(uint32_t(machine.parameters.size()));
+            for (auto& parameter : machine.parameters) {
+                writer.Value(uint8_t(parameter.opcode));
+                writer.Value(parameter.value);
+            }
+        }
+    }
+
+    // Written aside and renamed, a concurrent launch never maps a partial index
+    std::string temp = index_path + ".tmp";
+    FILE* file = fopen(temp.c_str(), "wb");
+    if (file) {
+        size_t written = fwrite(writer.data.data(), 1, writer.data.size(), file);
+        fclose(file);
+        if (written == writer.data.size() && rename(temp.c_str(), index_path.c_str()) == 0)
+            return;
+        remove(temp.c_str());
+    }
+}
+
+static bool Restore(const std::string& index_path, std::vector<Compiler>& compilers, std::vector<Driver>& drivers, std::set<std::string>& dependencies)
+{
+    int fd = open(index_path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    Reader reader = { (char*)data, (char*)data + size };
+    bool header = reader.Value<uint32_t>() == index_magic &&
+                  reader.Value<uint32_t>() == index_version;
+    bool valid = header;
+
+    uint32_t dependency_count = header ? reader.Value<uint32_t>() : 0;
+    for (uint32_t i = 0; i < dependency_count && reader.failed == false; ++i) {
+        auto path = reader.String();
+        auto time = reader.Value<int64_t>();
+        valid &= (reader.failed == false && ModifiedTime(path) == time);
+        dependencies.insert(path);
+    }
+
+    // Image hashes are kept even when a dependency changed, HashImage checks
+    // the modified time of every image on its own
+    uint32_t image_count = header ? reader.Value<uint32_t>() : 0;
+    for (uint32_t i = 0; i < image_count && reader.failed == false; ++i) {
+        auto path = reader.String();
+        auto time = reader.Value<int64_t>();
+        auto hash = reader.String();
+        if (reader.failed == false)
+            images[path] = { time, hash };
+    }
+    if (reader.failed)
+        images.clear();
+
+    uint32_t compiler_count = valid ? reader.Value<uint32_t>() : 0;
+    for (uint32_t i = 0; i < compiler_count && reader.failed == false; ++i) {
+        Compiler compiler;
+        compiler.name = reader.String();
+        compiler.path = reader.String();
+        compiler.hash = reader.String();
+        compilers.push_back(compiler);
+    }
+
+    uint32_t driver_count = valid ? reader.Value<uint32_t>() : 0;
+    for (uint32_t i = 0; i < driver_count && reader.failed == false; ++i) {
+        Driver driver;
+        uint32_t name_count = reader.Value<uint32_t>();
+        for (uint32_t j = 0; j < name_count && reader.failed == false; ++j) {
+            driver.name.push_back(reader.String());
+        }
+        driver.hash = reader.String();
+        uint32_t machine_count = reader.Value<uint32_t>();
+        for (uint32_t j = 0; j < machine_count && reader.failed == false; ++j) {
+            Machine machine;
+            machine.name = reader.String();
+            machine.entry = reader.String();
+            machine.strings = reader.String();
+            machine.key = reader.String();
+            uint32_t parameter_count = reader.Value<uint32_t>();
+            for (uint32_t k = 0; k < parameter_count && reader.failed == false; ++k) {
+                Parameter parameter;
+                uint8_t opcode = reader.Value<uint8_t>();
+                parameter.opcode = Parameter::Opcode(opcode);
+                parameter.value = reader.Value<uint32_t>();
+
+                // A stale or damaged index falls back to parsing the ini files
+                switch (opcode) {
+                case Parameter::PushImmediate:
+                case Parameter::PushStack:
+                    break;
+                case Parameter::PushString:
+                    reader.failed |= parameter.value >= machine.strings.size();
+                    break;
+                case Parameter::PushBuffer:
+                    reader.failed |= parameter.value >= Parameter::BufferCount;
+                    break;
+                default:
+                    reader.failed = true;
+                    break;
+                }
+                machine.parameters.push_back(parameter);
+            }
+            driver.machines.push_back(machine);
+        }
+        if (driver.name.empty())
+            reader.failed = true;
+        drivers.push_back(driver);
+    }
+
+    munmap(data, size);
+
+    if (valid == false || reader.failed) {
+        compilers.clear();
+        drivers.clear();
+        dependencies.clear();
+        return false;
+    }
+    return true;
+}
+
+static void Watch(const std::set<std::string>& paths)
+{
+#if defined(__linux__)
+    if (watch_fd >= 0)
+        close(watch_fd);
+    watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch_fd < 0)
+        return;
+    for (auto& path : paths) {
+        inotify_add_watch(watch_fd, path.c_str(), IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO);
+    }
+#else
+    for (int fd : watch_fds) {
+        close(fd);
+    }
+    watch_fds.clear();
+    if (watch_fd >= 0)
+        close(watch_fd);
+    watch_fd = kqueue();
+    if (watch_fd < 0)
+        return;
+    for (auto& path : paths) {
+        int fd = open(path.c_str(), O_EVTONLY);
+        if (fd < 0)
+            continue;
+        struct kevent event;
+        EV_SET(&event, fd, EVFILT_VNODE, EV_ADD | EV_CLEAR, NOTE_ATTRIB | NOTE_DELETE | NOTE_EXTEND | NOTE_RENAME | NOTE_WRITE, 0, nullptr);
+        kevent(watch_fd, &event, 1, nullptr, 0, nullptr);
+        watch_fds.push_back(fd);
+    }
+#endif
+}
+
+bool Changed()
+{
+    if (watch_fd < 0)
+        return false;
+
+    bool changed = false;
+#if defined(__linux__)
+    char buffer[4096];
+    while (read(watch_fd, buffer, sizeof(buffer)) > 0) {
+        changed = true;
+    }
+#else
+    struct kevent events[16];
+    struct timespec timeout = {};
+    while (kevent(watch_fd, nullptr, 0, events, 16, &timeout) > 0) {
+        changed = true;
+    }
+#endif
+    return changed;
+}
+
+void Load(const std::string& compiler_path, const std::string& driver_path, const std::string& shader_path, const std::string& index_path)
+{
+    auto& compilers = ShaderCompiler::compilers;
+    auto& drivers = ShaderCompiler::drivers;
+
+    std::set<std::string> dependencies;
+    if (Restore(index_path, compilers, drivers, dependencies) == false) {
+        Parse(compiler_path, driver_path, compilers, drivers, dependencies);
+        Save(index_path, compilers, drivers, dependencies);
+    }
+
+    dependencies.insert(shader_path);
+    Watch(dependencies);
+}
+
+void Reload(const std::string& compiler_path, const std::string& driver_path, const std::string& shader_path, const std::string& index_path, std::vector<Compiler>& compilers, std::vector<Driver>& drivers)
+{
+    std::set<std::string> dependencies;
+    Parse(compiler_path, driver_path, compilers, drivers, dependencies);
+    Save(index_path, compilers, drivers, dependencies);
+
+    dependencies.insert(shader_path);
+    Watch(dependencies);
+}
+
+};  // namespace Catalog
@@ -0,0 +1,15 @@
+#pragma once
+
+namespace ShaderCompiler {
+struct Compiler;
+struct Driver;
+};  // namespace ShaderCompiler
+
+namespace Catalog {
+
+void Load(const std::string& compiler_path, const std::string& driver_path, const std::string& shader_path, const std::string& index_path);
+void Reload(const std::string& compiler_path, const std::string& driver_path, const std::string& shader_path, const std::string& index_path, std::vector<ShaderCompiler::Compiler>& compilers, std::vector<ShaderCompiler::Driver>& drivers);
+void Parse(const std::string& compiler_path, const std::string& driver_path, std::vector<ShaderCompiler::Compiler>& compilers, std::vector<ShaderCompiler::Driver>& drivers, std::set<std::string>& dependencies);
+bool Changed();
+
+};  // namespace Catalog
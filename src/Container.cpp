@@ -0,0 +1,215 @@
+#include <string.h>
+#include <string_view>
+#include <vector>
+#include "Container.h"
+
+namespace Container {
+
+uint32_t Span::Word(size_t offset) const
+{
+    uint32_t value = 0;
+    if (offset <= size && size - offset >= sizeof(value))
+        memcpy(&value, data + offset, sizeof(value));
+    return value;
+}
+
+Span Span::Sub(size_t offset, size_t length) const
+{
+    if (data == nullptr || offset > size || length > size - offset)
+        return Span();
+    return Span(data + offset, length);
+}
+
+Format Identify(Span binary)
+{
+    if (binary.Word(0) == 'CBXD')
+        return Format::DXBC;
+    if (binary.size >= 4 && memcmp(binary.data, "MBS", 3) == 0)
+        return Format::MBS;
+    if (binary.Word(0) == 0x464C457F)
+        return Format::ELF;
+    return Format::Unknown;
+}
+
+// DXBC : header, chunk count at 28 and the offset of every chunk after it,
+// a chunk is a tag and a size in front of its data
+template <class Visit>
+static bool DXBC(Span binary, Visit& visit)
+{
+    uint32_t count = binary.Word(28);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!binary.Sub(32 + size_t(i) * 4, 4))
+            break;
+        uint32_t offset = binary.Word(32 + size_t(i) * 4);
+        Span header = binary.Sub(offset, 8);
+        Span data = binary.Sub(size_t(offset) + 8, binary.Word(size_t(offset) + 4));
+        if (!header || !data)
+            continue;
+        Section section = { std::string_view((const char*)header.data, 4), i, offset, -1, data };
+        if (visit(section))
+            return true;
+    }
+    return false;
+}
+
+// MBS : chunks of a tag, a size and the data, aligned to 4 bytes. The file
+// is one chunk and a chunk whose data is made of chunks holds them, such as
+// CVER and CFRA holding DBIN or OBJC
+static bool Tag(Span chunks, size_t offset)
+{
+    Span tag = chunks.Sub(offset, 4);
+    if (!tag)
+        return false;
+    for (size_t i = 0; i < 4; ++i) {
+        char c = char(tag.data[i]);
+        if ((c < 'A' || c > 'Z') && (c < '0' || c > '9'))
+            return false;
+    }
+    return true;
+}
+
+static size_t Next(size_t offset, size_t size)
+{
+    return (offset + 8 + size + 3) & ~size_t(3);
+}
+
+static bool Chunks(Span chunks)
+{
+    if (chunks.size < 8)
+        return false;
+    for (size_t offset = 0; offset < chunks.size; ) {
+        Span data = chunks.Sub(offset + 8, chunks.Word(offset + 4));
+        if (Tag(chunks, offset) == false || !data)
+            return false;
+        offset = Next(offset, data.size);
+    }
+    return true;
+}
+
+template <class Visit>
+static bool MBS(Span binary, Span chunks, int parent, int& index, Visit& visit)
+{
+    for (size_t offset = 0; offset < chunks.size; ) {
+        Span data = chunks.Sub(offset + 8, chunks.Word(offset + 4));
+        if (Tag(chunks, offset) == false || !data)
+            return false;
+        int self = index++;
+        Section section = { std::string_view((const char*)chunks.data + offset, 4), uint32_t(self), uint32_t(chunks.data + offset - binary.data), parent, data };
+        if (visit(section))
+            return true;
+        if (Chunks(data) && MBS(binary, data, self, index, visit))
+            return true;
+        offset = Next(offset, data.size);
+    }
+    return false;
+}
+
+// ELF : 32-bit section headers, names come from the section of strings
+template <class Visit>
+static bool ELF(Span binary, Visit& visit)
+{
+    if (binary.size < 52 || binary.data[4] != 1)
+        return false;
+    uint32_t shoff = binary.Word(32);
+    uint16_t shentsize = binary.Word(46) & 0xFFFF;
+    uint16_t shnum = binary.Word(48) & 0xFFFF;
+    uint16_t shstrndx = binary.Word(50) & 0xFFFF;
+    if (shentsize < 40 || shstrndx >= shnum)
+        return false;
+    Span headers = binary.Sub(shoff, size_t(shnum) * shentsize);
+    if (!headers)
+        return false;
+    Span strings = binary.Sub(headers.Word(size_t(shstrndx) * shentsize + 16), headers.Word(size_t(shstrndx) * shentsize + 20));
+    for (uint16_t i = 0; i < shnum; ++i) {
+        size_t header = size_t(i) * shentsize;
+        uint32_t name = headers.Word(header + 0);
+        uint32_t offset = headers.Word(header + 16);
+        Span data = binary.Sub(offset, headers.Word(header + 20));
+        if (!data)
+            continue;
+        std::string_view title;
+        if (name < strings.size) {
+            const char* text = (const char*)strings.data + name;
+            title = std::string_view(text, strnlen(text, strings.size - name));
+        }
+        Section section = { title, i, offset, -1, data };
+        if (visit(section))
+            return true;
+    }
+    return false;
+}
+
+// QCOM : the section table offset and count sit in the header, an entry is
+// five words starting with the number, the offset and the size of a section
+template <class Visit>
+static bool QCOM(Span binary, Visit& visit)
+{
+    uint32_t table = binary.Word(20);
+    uint32_t count = binary.Word(24);
+    for (uint32_t i = 0; i < count; ++i) {
+        Span entry = binary.Sub(table + size_t(i) * 20, 20);
+        if (!entry)
+            break;
+        uint32_t offset = entry.Word(4);
+        Span data = binary.Sub(offset, entry.Word(8));
+        if (!data)
+            continue;
+        Section section = { std::string_view(), entry.Word(0), offset, -1, data };
+        if (visit(section))
+            return true;
+    }
+    return false;
+}
+
+template <class Visit>
+static void Walk(Span binary, Format format, Visit& visit)
+{
+    int index = 0;
+    switch (format) {
+    case Format::DXBC:
+        DXBC(binary, visit);
+        break;
+    case Format::MBS:
+        MBS(binary, binary, -1, index, visit);
+        break;
+    case Format::ELF:
+        ELF(binary, visit);
+        break;
+    case Format::QCOM:
+        QCOM(binary, visit);
+        break;
+    default:
+        break;
+    }
+}
+
+std::vector<Section> Parse(Span binary, Format format)
+{
+    std::vector<Section> sections;
+    auto visit = [&](const Section& section) {
+        sections.push_back(section);
+        return false;
+    };
+    Walk(binary, format, visit);
+    return sections;
+}
+
+std::vector<Section> Parse(Span binary)
+{
+    return Parse(binary, Identify(binary));
+}
+
+Span Find(Span binary, Format format, std::string_view name)
+{
+    Span found;
+    auto visit = [&](const Section& section) {
+        if (section.name != name)
+            return false;
+        found = section.data;
+        return true;
+    };
+    Walk(binary, format, visit);
+    return found;
+}
+
+};  // namespace Container
@@ -0,0 +1,44 @@
+#pragma once
+
+// Views into shader containers
+//
+// A binary is walked through the directory of its own format, the chunk
+// offsets of DXBC, the nested chunks of a Mali MBS file, the section headers
+// of ELF and the section table of an Adreno binary, never by scanning words.
+// Nothing is copied, every section is a view checked to lie inside of the
+// binary it was parsed from.
+namespace Container {
+
+struct Span {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    Span() = default;
+    Span(const void* data, size_t size) : data((const uint8_t*)data), size(size) {}
+    explicit operator bool() const { return data != nullptr; }
+    uint32_t Word(size_t offset) const;
+    Span Sub(size_t offset, size_t size) const;
+};
+
+enum class Format : uint8_t {
+    Unknown,
+    DXBC,
+    MBS,
+    ELF,
+    QCOM,
+};
+
+struct Section {
+    std::string_view name;
+    uint32_t id;        // Index in the directory or the Adreno section number
+    uint32_t offset;    // Start of the entry, its header for chunked formats
+    int parent;         // Enclosing MBS chunk
+    Span data;
+};
+
+Format Identify(Span binary);
+std::vector<Section> Parse(Span binary, Format format);
+std::vector<Section> Parse(Span binary);
+Span Find(Span binary, Format format, std::string_view name);
+
+};  // namespace Container
@@ -1,6 +1,12 @@
+#include <ctype.h>
 #include <string>
+#include <string_view>
+#include "Container.h"
+#include "D3DDisassembler.h"
 #include "Logger.h"
 #include "ShaderCompiler.h"
+#include "Sink.h"
+#include "Timeline.h"
 #include "VirtualMachine.h"
 #include "../mine/syscall/allocator.h"
 #include "../mine/x86/x86_i386.h"
@@ -9,6 +15,118 @@
 
 namespace D3DCompiler {
 
+using ShaderCompiler::Instruction;
+
+bool emulate_disassembly;
+
+static const Sink::Syntax syntax = {
+    .comments = { "//" },
+    .files = {
+        { "r", Instruction::Register },
+        { "x", Instruction::Register },
+        { "c", Instruction::Constant },
+        { "cb", Instruction::Constant },
+        { "icb", Instruction::Constant },
+        { "i", Instruction::Constant },
+        { "b", Instruction::Constant },
+        { "p", Instruction::Predicate },
+        { "v", Instruction::Input },
+        { "o", Instruction::Output },
+        { "oC", Instruction::Output },
+        { "s", Instruction::Sampler },
+        { "t", Instruction::Sampler },
+        { "u", Instruction::Sampler },
+    },
+    .units = {
+        { "default", Instruction::Flow },
+        { "texkill", Instruction::Flow },
+        { "dcl", Instruction::None },
+        { "vs_", Instruction::None },
+        { "ps_", Instruction::None },
+        { "gs_", Instruction::None },
+        { "hs_", Instruction::None },
+        { "ds_", Instruction::None },
+        { "cs_", Instruction::None },
+        { "def", Instruction::None },
+        { "ld_raw", Instruction::Memory },
+        { "ld_structured", Instruction::Memory },
+        { "ld_uav", Instruction::Memory },
+        { "store_", Instruction::Memory },
+        { "atomic_", Instruction::Memory },
+        { "imm_atomic_", Instruction::Memory },
+        { "sync", Instruction::Sync },
+        { "tex", Instruction::Texture },
+        { "sample", Instruction::Texture },
+        { "gather", Instruction::Texture },
+        { "ld", Instruction::Texture },
+        { "resinfo", Instruction::Texture },
+        { "lod", Instruction::Texture },
+        { "if", Instruction::Flow },
+        { "else", Instruction::Flow },
+        { "endif", Instruction::Flow },
+        { "loop", Instruction::Flow },
+        { "endloop", Instruction::Flow },
+        { "rep", Instruction::Flow },
+        { "endrep", Instruction::Flow },
+        { "break", Instruction::Flow },
+        { "continue", Instruction::Flow },
+        { "call", Instruction::Flow },
+        { "ret", Instruction::Flow },
+        { "label", Instruction::Flow },
+        { "switch", Instruction::Flow },
+        { "case", Instruction::Flow },
+        { "endswitch", Instruction::Flow },
+        { "discard", Instruction::Flow },
+        { "rcp", Instruction::Special },
+        { "rsq", Instruction::Special },
+        { "exp", Instruction::Special },
+        { "log", Instruction::Special },
+        { "sincos", Instruction::Special },
+        { "sqrt", Instruction::Special },
+    },
+};
+
+// Compares the instruction lines of the native listing against the one from
+// the emulated disassembler, comments and spacing are left out
+static void Verify(const std::string& emulated, const std::string& native)
+{
+    auto next = [](const std::string& text, size_t& offset, std::string& line) {
+        while (offset < text.size()) {
+            size_t end = text.find('\n', offset);
+            if (end == std::string::npos)
+                end = text.size();
+            line.clear();
+            for (size_t i = offset; i < end; ++i) {
+                if (isspace((unsigned char)text[i]) == 0)
+                    line += text[i];
+            }
+            offset = end + 1;
+            if (line.empty() == false && line.compare(0, 2, "//") != 0)
+                return true;
+        }
+        return false;
+    };
+
+    size_t emulated_offset = 0;
+    size_t native_offset = 0;
+    std::string emulated_line;
+    std::string native_line;
+    for (int count = 0;; ++count) {
+        bool emulated_more = next(emulated, emulated_offset, emulated_line);
+        bool native_more = next(native, native_offset, native_line);
+        if (emulated_more == false && native_more == false) {
+            Logger<CONSOLE>("Verify : %d lines match\n", count);
+            return;
+        }
+        if (emulated_more != native_more || emulated_line != native_line) {
+            Logger<CONSOLE>("Verify : line %d differs\n", count + 1);
+            Logger<CONSOLE>("  Emulated : %s\n", emulated_more ? emulated_line.c_str() : "");
+            Logger<CONSOLE>("  Native   : %s\n", native_more ? native_line.c_str() : "");
+            return;
+        }
+    }
+}
+
 size_t RunD3DAssemble(mine* cpu, size_t(*symbol)(mine*, void*, const char*))
 {
     auto* allocator = cpu->Allocator;
@@ -229,6 +347,8 @@ mine* NextProcess(mine* cpu)
     switch (stack[0]) {
     case 'D3DA':
     case 'D3DC': {
+        Trace<TRACE_D3D>("%-12s : %08X", "D3DC", EAX);
+        Timeline::Scope scope("D3DCompiler::D3DC");
         auto* error = (uint32_t*)(memory + stack[2]);
         if (error) {
 //          auto& size = error[2];
@@ -248,6 +368,16 @@ mine* NextProcess(mine* cpu)
             auto& output = ShaderCompiler::outputs[""];
             output.binary.assign(code, code + size);
 
+            if (emulate_disassembly == false) {
+                Timeline::Scope scope("D3DDisassembler");
+                Sink sink;
+                if (D3DDisassembler::Disassemble(sink, output.binary.data(), output.binary.size())) {
+                    sink.Flush(output, &syntax);
+                    ShaderCompiler::completed = true;
+                    break;
+                }
+            }
+
             size_t address = D3DCompiler::RunD3DDisassemble(cpu, VirtualMachine::GetProcAddress);
             if (address) {
                 Push32(0);
@@ -262,6 +392,8 @@ mine* NextProcess(mine* cpu)
         break;
     }
     case 'D3DD': {
+        Trace<TRACE_D3D>("%-12s : %08X", "D3DD", EAX);
+        Timeline::Scope scope("D3DCompiler::D3DD");
         auto* blob = (uint32_t*)(memory + stack[1]);
         if (blob && EAX == 0) {
             auto& size = blob[2];
@@ -269,8 +401,20 @@ mine* NextProcess(mine* cpu)
             auto* code = (char*)(memory + pointer);
 
             auto& output = ShaderCompiler::outputs[""];
-            output.disasm.assign(code, code + size);
-            output.disasm.resize(strlen(output.disasm.c_str()));
+            Sink sink;
+            sink.Write(code, size);
+            sink.Flush(output, &syntax);
+
+            ShaderCompiler::Output native;
+            if (D3DDisassembler::Disassemble(sink, output.binary.data(), output.binary.size())) {
+                sink.Flush(native);
+                Verify(output.disasm, native.disasm);
+            }
+            else {
+                sink.Clear();
+                Logger<CONSOLE>("Verify : %s\n", "Native disassembler does not support this shader");
+            }
+            ShaderCompiler::completed = true;
         }
         else {
             Logger<CONSOLE>("Disassemble : %08X\n", EAX);
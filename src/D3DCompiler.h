@@ -4,6 +4,10 @@ struct mine;
 
 namespace D3DCompiler {
 
+// Disassemble through the vendor DLL instead of D3DDisassembler and report
+// where the two listings differ
+extern bool emulate_disassembly;
+
 size_t RunD3DAssemble(mine* cpu, size_t(*symbol)(mine*, void*, const char*));
 size_t RunD3DCompile(mine* cpu, size_t(*symbol)(mine*, void*, const char*));
 size_t RunD3DDisassemble(mine* cpu, size_t(*symbol)(mine*, void*, const char*));
@@ -0,0 +1,1261 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Container.h"
+#include "ShaderCompiler.h"
+#include "Sink.h"
+#include "D3DDisassembler.h"
+
+namespace D3DDisassembler {
+
+static const char components[] = "xyzw";
+
+static std::string_view String(Container::Span span, size_t offset)
+{
+    if (offset >= span.size)
+        return std::string_view();
+    const char* text = (const char*)span.data + offset;
+    return std::string_view(text, strnlen(text, span.size - offset));
+}
+
+static uint16_t Half(Container::Span span, size_t offset)
+{
+    Container::Span half = span.Sub(offset, 2);
+    return half ? uint16_t(half.data[0] | (half.data[1] << 8)) : 0;
+}
+
+// Shader Model 1 - 3 : a version token, then instruction tokens followed by
+// their parameters and comment blocks, up to the end token
+struct Legacy {
+    const uint32_t* tokens;
+    size_t count;
+    bool pixel;
+    int major;
+    int minor;
+};
+
+struct LegacyOpcode {
+    uint16_t opcode;
+    const char* name;
+    uint8_t dst;
+    uint8_t src;
+};
+
+static const LegacyOpcode legacy_opcodes[] = {
+    { 0,    "nop",          0, 0 },
+    { 1,    "mov",          1, 1 },
+    { 2,    "add",          1, 2 },
+    { 3,    "sub",          1, 2 },
+    { 4,    "mad",          1, 3 },
+    { 5,    "mul",          1, 2 },
+    { 6,    "rcp",          1, 1 },
+    { 7,    "rsq",          1, 1 },
+    { 8,    "dp3",          1, 2 },
+    { 9,    "dp4",          1, 2 },
+    { 10,   "min",          1, 2 },
+    { 11,   "max",          1, 2 },
+    { 12,   "slt",          1, 2 },
+    { 13,   "sge",          1, 2 },
+    { 14,   "exp",          1, 1 },
+    { 15,   "log",          1, 1 },
+    { 16,   "lit",          1, 1 },
+    { 17,   "dst",          1, 2 },
+    { 18,   "lrp",          1, 3 },
+    { 19,   "frc",          1, 1 },
+    { 20,   "m4x4",         1, 2 },
+    { 21,   "m4x3",         1, 2 },
+    { 22,   "m3x4",         1, 2 },
+    { 23,   "m3x3",         1, 2 },
+    { 24,   "m3x2",         1, 2 },
+    { 25,   "call",         0, 1 },
+    { 26,   "callnz",       0, 2 },
+    { 27,   "loop",         0, 2 },
+    { 28,   "ret",          0, 0 },
+    { 29,   "endloop",      0, 0 },
+    { 30,   "label",        0, 1 },
+    { 31,   "dcl",          0, 0 },
+    { 32,   "pow",          1, 2 },
+    { 33,   "crs",          1, 2 },
+    { 34,   "sgn",          1, 3 },
+    { 35,   "abs",          1, 1 },
+    { 36,   "nrm",          1, 1 },
+    { 37,   "sincos",       1, 3 },
+    { 38,   "rep",          0, 1 },
+    { 39,   "endrep",       0, 0 },
+    { 40,   "if",           0, 1 },
+    { 41,   "if",           0, 2 },
+    { 42,   "else",         0, 0 },
+    { 43,   "endif",        0, 0 },
+    { 44,   "break",        0, 0 },
+    { 45,   "break",        0, 2 },
+    { 46,   "mova",         1, 1 },
+    { 47,   "defb",         0, 0 },
+    { 48,   "defi",         0, 0 },
+    { 64,   "texcoord",     1, 0 },
+    { 65,   "texkill",      1, 0 },
+    { 66,   "tex",          1, 0 },
+    { 67,   "texbem",       1, 1 },
+    { 68,   "texbeml",      1, 1 },
+    { 69,   "texreg2ar",    1, 1 },
+    { 70,   "texreg2gb",    1, 1 },
+    { 71,   "texm3x2pad",   1, 1 },
+    { 72,   "texm3x2tex",   1, 1 },
+    { 73,   "texm3x3pad",   1, 1 },
+    { 74,   "texm3x3tex",   1, 1 },
+    { 76,   "texm3x3spec",  1, 2 },
+    { 77,   "texm3x3vspec", 1, 1 },
+    { 78,   "expp",         1, 1 },
+    { 79,   "logp",         1, 1 },
+    { 80,   "cnd",          1, 3 },
+    { 81,   "def",          0, 0 },
+    { 82,   "texreg2rgb",   1, 1 },
+    { 83,   "texdp3tex",    1, 1 },
+    { 84,   "texm3x2depth", 1, 1 },
+    { 85,   "texdp3",       1, 1 },
+    { 86,   "texm3x3",      1, 1 },
+    { 87,   "texdepth",     1, 0 },
+    { 88,   "cmp",          1, 3 },
+    { 89,   "bem",          1, 2 },
+    { 90,   "dp2add",       1, 3 },
+    { 91,   "dsx",          1, 1 },
+    { 92,   "dsy",          1, 1 },
+    { 93,   "texldd",       1, 4 },
+    { 94,   "setp",         1, 2 },
+    { 95,   "texldl",       1, 2 },
+    { 96,   "break",        0, 1 },
+};
+
+static uint32_t LegacyType(uint32_t token)
+{
+    return ((token >> 28) & 0x7) | ((token >> 8) & 0x18);
+}
+
+static bool LegacyRegister(std::string& text, const Legacy& shader, uint32_t token)
+{
+    uint32_t type = LegacyType(token);
+    uint32_t number = token & 0x7FF;
+    switch (type) {
+    case 0:     text += "r";                                break;
+    case 1:     text += "v";                                break;
+    case 2:     text += "c";                                break;
+    case 3:     text += shader.pixel ? "t" : "a";           break;
+    case 4: {
+        static const char* const rastout[] = { "oPos", "oFog", "oPts" };
+        if (number >= 3)
+            return false;
+        text += rastout[number];
+        return true;
+    }
+    case 5:     text += "oD";                               break;
+    case 6:     text += shader.major >= 3 ? "o" : "oT";     break;
+    case 7:     text += "i";                                break;
+    case 8:     text += "oC";                               break;
+    case 9:     text += "oDepth";                           return true;
+    case 10:    text += "s";                                break;
+    case 11:    text += "c";    number += 2048;             break;
+    case 12:    text += "c";    number += 4096;             break;
+    case 13:    text += "c";    number += 6144;             break;
+    case 14:    text += "b";                                break;
+    case 15:    text += "aL";                               return true;
+    case 17: {
+        static const char* const misc[] = { "vPos", "vFace" };
+        if (number >= 2)
+            return false;
+        text += misc[number];
+        return true;
+    }
+    case 18:    text += "l";                                break;
+    case 19:    text += "p";                                break;
+    default:
+        return false;
+    }
+    text += std::to_string(number);
+    return true;
+}
+
+static bool LegacySource(std::string& text, const Legacy& shader, size_t& index, size_t end)
+{
+    static const char* const prefixes[] = { "", "-", "", "-", "", "-", "1 - ", "", "-", "", "", "", "-", "!" };
+    static const char* const suffixes[] = { "", "", "_bias", "_bias", "_bx2", "_bx2", "", "_x2", "_x2", "_dz", "_dw", "_abs", "_abs", "" };
+
+    if (index >= end)
+        return false;
+    uint32_t token = shader.tokens[index++];
+    uint32_t modifier = (token >> 24) & 0xF;
+    if (modifier >= 14)
+        return false;
+
+    std::string name;
+    if (LegacyRegister(name, shader, token) == false)
+        return false;
+
+    // vs_1_1 always addresses through a0.x, later models name the register
+    if (token & (1 << 13)) {
+        std::string address = "a0.x";
+        if (shader.major >= 2) {
+            if (index >= end)
+                return false;
+            uint32_t relative = shader.tokens[index++];
+            address.clear();
+            if (LegacyRegister(address, shader, relative) == false)
+                return false;
+            if (LegacyType(relative) != 15) {
+                address += '.';
+                address += components[(relative >> 16) & 0x3];
+            }
+        }
+        name += '[' + address + ']';
+    }
+
+    text += prefixes[modifier];
+    text += name;
+    text += suffixes[modifier];
+
+    uint32_t swizzle = (token >> 16) & 0xFF;
+    if (swizzle != 0xE4) {
+        text += '.';
+        if (swizzle == (swizzle & 0x3) * 0x55) {
+            text += components[swizzle & 0x3];
+        }
+        else {
+            for (int i = 0; i < 4; ++i)
+                text += components[(swizzle >> (i * 2)) & 0x3];
+        }
+    }
+    return true;
+}
+
+static bool LegacyDestination(std::string& text, std::string& suffix, const Legacy& shader, size_t& index, size_t end)
+{
+    static const char* const shifts[] = { "", "_x2", "_x4", "_x8", "", "", "", "", "", "", "", "", "", "_d8", "_d4", "_d2" };
+
+    if (index >= end)
+        return false;
+    uint32_t token = shader.tokens[index++];
+    if (LegacyRegister(text, shader, token) == false)
+        return false;
+
+    if (token & (1 << 13)) {
+        if (index >= end)
+            return false;
+        std::string address;
+        if (LegacyRegister(address, shader, shader.tokens[index++]) == false)
+            return false;
+        text += '[' + address + ']';
+    }
+
+    uint32_t mask = (token >> 16) & 0xF;
+    if (mask != 0 && mask != 0xF) {
+        text += '.';
+        for (int i = 0; i < 4; ++i) {
+            if (mask & (1 << i))
+                text += components[i];
+        }
+    }
+
+    uint32_t modifier = (token >> 20) & 0xF;
+    suffix += shifts[(token >> 24) & 0xF];
+    if (modifier & 1)
+        suffix += "_sat";
+    if (modifier & 2)
+        suffix += "_pp";
+    if (modifier & 4)
+        suffix += "_centroid";
+    return true;
+}
+
+// The constant table rides in a comment block, the listing opens with the
+// parameters and their registers the same way D3DXDisassembleShader does
+static void LegacyHeader(Sink& sink, Container::Span table)
+{
+    static const char* const types[] = {
+        "void", "bool", "int", "float", "string", "texture", "texture1D", "texture2D",
+        "texture3D", "textureCUBE", "sampler", "sampler1D", "sampler2D", "sampler3D", "samplerCUBE",
+    };
+    static const char* const sets[] = { "b", "i", "c", "s" };
+
+    struct Constant {
+        std::string declaration;
+        std::string name;
+        std::string reg;
+        int size;
+    };
+    std::vector<Constant> constants;
+    size_t width = 4;
+
+    uint32_t count = table.Word(12);
+    uint32_t info = table.Word(16);
+    for (uint32_t i = 0; i < count; ++i) {
+        size_t offset = info + size_t(i) * 20;
+        if (!table.Sub(offset, 20))
+            break;
+        Constant constant;
+        constant.name = String(table, table.Word(offset));
+        uint16_t set = Half(table, offset + 4);
+        constant.reg = set < 4 ? sets[set] : "?";
+        constant.reg += std::to_string(Half(table, offset + 6));
+        constant.size = Half(table, offset + 8);
+
+        uint32_t type_info = table.Word(offset + 12);
+        uint16_t type_class = Half(table, type_info + 0);
+        uint16_t type = Half(table, type_info + 2);
+        uint16_t rows = Half(table, type_info + 4);
+        uint16_t columns = Half(table, type_info + 6);
+        uint16_t elements = Half(table, type_info + 8);
+        std::string declaration = type < std::size(types) ? types[type] : "?";
+        switch (type_class) {
+        case 1:
+            declaration += std::to_string(columns);
+            break;
+        case 2:
+            declaration = "row_major " + declaration + std::to_string(rows) + 'x' + std::to_string(columns);
+            break;
+        case 3:
+            declaration += std::to_string(rows) + 'x' + std::to_string(columns);
+            break;
+        case 5:
+            declaration = "struct";
+            break;
+        default:
+            break;
+        }
+        declaration += ' ' + constant.name;
+        if (elements > 1)
+            declaration += '[' + std::to_string(elements) + ']';
+        constant.declaration = declaration;
+        width = std::max(width, constant.name.size());
+        constants.push_back(constant);
+    }
+
+    std::string_view creator = String(table, table.Word(4));
+    sink.Write("//\n");
+    sink.Print("// Generated by %.*s\n", int(creator.size()), creator.data());
+    if (constants.empty() == false) {
+        sink.Write("//\n// Parameters:\n//\n");
+        for (auto& constant : constants) {
+            sink.Print("//   %s;\n", constant.declaration.c_str());
+        }
+        sink.Write("//\n//\n// Registers:\n//\n");
+        sink.Print("//   %-*s Reg   Size\n", int(width), "Name");
+        sink.Print("//   %s ----- ----\n", std::string(width, '-').c_str());
+        for (auto& constant : constants) {
+            sink.Print("//   %-*s %-5s %4d\n", int(width), constant.name.c_str(), constant.reg.c_str(), constant.size);
+        }
+    }
+    sink.Write("//\n\n");
+}
+
+static bool LegacyListing(Sink& sink, const uint32_t* tokens, size_t count)
+{
+    static const char* const usages[] = {
+        "position", "blendweight", "blendindices", "normal", "psize", "texcoord", "tangent",
+        "binormal", "tessfactor", "positiont", "color", "fog", "depth", "sample",
+    };
+    static const char* const samplers[] = { "", "_1d", "_2d", "_cube", "_volume" };
+    static const char* const comparisons[] = { "", "_gt", "_eq", "_ge", "_lt", "_ne", "_le", "" };
+
+    Legacy shader = { tokens, count, (tokens[0] >> 16) == 0xFFFF, int((tokens[0] >> 8) & 0xFF), int(tokens[0] & 0xFF) };
+
+    // Comment blocks directly after the version token
+    for (size_t index = 1; index < count && (tokens[index] & 0xFFFF) == 0xFFFE; ) {
+        size_t length = (tokens[index] >> 16) & 0x7FFF;
+        Container::Span comment(tokens + index + 1, std::min(length, count - index - 1) * sizeof(uint32_t));
+        if (comment.Word(0) == 'BATC') {
+            LegacyHeader(sink, comment.Sub(4, comment.size - 4));
+            break;
+        }
+        index += 1 + length;
+    }
+
+    const char* type = shader.pixel ? "ps" : "vs";
+    if (shader.major == 2 && shader.minor == 1)
+        sink.Print("    %s_2_x\n", type);
+    else if (shader.minor == 0xFF)
+        sink.Print("    %s_%d_sw\n", type, shader.major);
+    else
+        sink.Print("    %s_%d_%d\n", type, shader.major, shader.minor);
+
+    size_t index = 1;
+    while (index < count) {
+        uint32_t token = tokens[index];
+        uint32_t opcode = token & 0xFFFF;
+        if (opcode == 0xFFFF)
+            break;
+        if (opcode == 0xFFFE) {
+            index += 1 + ((token >> 16) & 0x7FFF);
+            continue;
+        }
+        if (opcode == 0xFFFD) {
+            sink.Write("    phase\n");
+            index++;
+            continue;
+        }
+
+        auto it = std::find_if(std::begin(legacy_opcodes), std::end(legacy_opcodes), [opcode](auto& info) {
+            return info.opcode == opcode;
+        });
+        if (it == std::end(legacy_opcodes))
+            return false;
+
+        // Shader Model 2 and later carry the parameter count in the token
+        size_t begin = ++index;
+        size_t end = count;
+        if (shader.major >= 2) {
+            end = begin + ((token >> 24) & 0xF);
+            if (end > count)
+                return false;
+        }
+
+        std::string name = it->name;
+        int dst = it->dst;
+        int src = it->src;
+        uint32_t controls = (token >> 16) & 0xFF;
+        switch (opcode) {
+        case 41:
+        case 45:
+        case 94:
+            name += comparisons[controls & 0x7];
+            break;
+        case 64:
+            if (shader.major == 1 && shader.minor == 4) {
+                name = "texcrd";
+                src = 1;
+            }
+            break;
+        case 66:
+            if (shader.major >= 2 || (shader.major == 1 && shader.minor == 4)) {
+                name = controls == 1 ? "texldp" : controls == 2 ? "texldb" : "texld";
+                src = shader.major >= 2 ? 2 : 1;
+            }
+            break;
+        default:
+            break;
+        }
+
+        std::string predicate;
+        std::string suffix;
+        std::string operands;
+        auto separator = [&]() {
+            if (operands.empty() == false)
+                operands += ", ";
+        };
+
+        switch (opcode) {
+        case 31: {
+            if (index >= end)
+                return false;
+            uint32_t usage = tokens[index++];
+            if (index >= end)
+                return false;
+            uint32_t reg = LegacyType(tokens[index]);
+            if (LegacyDestination(operands, suffix, shader, index, end) == false)
+                return false;
+            if (reg == 10) {
+                uint32_t sampler = (usage >> 27) & 0xF;
+                if (sampler >= std::size(samplers))
+                    return false;
+                name += samplers[sampler];
+            }
+            else if ((shader.pixel == false || shader.major >= 3) && reg != 17) {
+                uint32_t semantic = usage & 0x1F;
+                uint32_t semantic_index = (usage >> 16) & 0xF;
+                if (semantic >= std::size(usages))
+                    return false;
+                name += '_';
+                name += usages[semantic];
+                if (semantic_index)
+                    name += std::to_string(semantic_index);
+            }
+            break;
+        }
+        case 47:
+        case 48:
+        case 81: {
+            if (LegacyDestination(operands, suffix, shader, index, end) == false)
+                return false;
+            size_t values = opcode == 47 ? 1 : 4;
+            if (index + values > end)
+                return false;
+            for (size_t i = 0; i < values; ++i) {
+                uint32_t value = tokens[index++];
+                char number[32];
+                if (opcode == 47) {
+                    snprintf(number, sizeof(number), "%s", value ? "true" : "false");
+                }
+                else if (opcode == 48) {
+                    snprintf(number, sizeof(number), "%d", int32_t(value));
+                }
+                else {
+                    float f;
+                    memcpy(&f, &value, sizeof(f));
+                    snprintf(number, sizeof(number), "%.9g", f);
+                }
+                operands += ", ";
+                operands += number;
+            }
+            break;
+        }
+        default:
+            if (dst && LegacyDestination(operands, suffix, shader, index, end) == false)
+                return false;
+            if (token & (1 << 28)) {
+                predicate = "(";
+                if (LegacySource(predicate, shader, index, end) == false)
+                    return false;
+                predicate += ") ";
+            }
+            if (shader.major >= 2) {
+                while (index < end) {
+                    separator();
+                    if (LegacySource(operands, shader, index, end) == false)
+                        return false;
+                }
+            }
+            else {
+                for (int i = 0; i < src; ++i) {
+                    separator();
+                    if (LegacySource(operands, shader, index, end) == false)
+                        return false;
+                }
+            }
+            break;
+        }
+        if (shader.major >= 2 && index != end)
+            return false;
+
+        const char* coissue = (shader.pixel && shader.major < 2 && (token & (1 << 30))) ? "+" : "";
+        sink.Print("    %s%s%s%s%s%s\n", coissue, predicate.c_str(), name.c_str(), suffix.c_str(), operands.empty() ? "" : " ", operands.c_str());
+    }
+
+    return true;
+}
+
+// Shader Model 4 - 5 : the SHDR/SHEX chunk holds a version and a length
+// token, then instructions whose first token carries their length
+static const char* const modern_opcodes[] = {
+    "add", "and", "break", "breakc", "call", "callc", "case", "continue",                                       // 0
+    "continuec", "cut", "default", "deriv_rtx", "deriv_rty", "discard", "div", "dp2",                           // 8
+    "dp3", "dp4", "else", "emit", "emitthencut", "endif", "endloop", "endswitch",                                // 16
+    "eq", "exp", "frc", "ftoi", "ftou", "ge", "iadd", "if",                                                     // 24
+    "ieq", "ige", "ilt", "imad", "imax", "imin", "imul", "ine",                                                 // 32
+    "ineg", "ishl", "ishr", "itof", "label", "ld", "ld_ms", "log",                                              // 40
+    "loop", "lt", "mad", "min", "max", "customdata", "mov", "movc",                                             // 48
+    "mul", "ne", "nop", "not", "or", "resinfo", "ret", "retc",                                                  // 56
+    "round_ne", "round_ni", "round_pi", "round_z", "rsq", "sample", "sample_c", "sample_c_lz",                  // 64
+    "sample_l", "sample_d", "sample_b", "sqrt", "switch", "sincos", "udiv", "ult",                              // 72
+    "uge", "umul", "umad", "umax", "umin", "ushr", "utof", "xor",                                               // 80
+    "dcl_resource", "dcl_constantbuffer", "dcl_sampler", "dcl_indexrange",                                      // 88
+    "dcl_outputtopology", "dcl_inputprimitive", "dcl_maxout", "dcl_input",                                      // 92
+    "dcl_input_sgv", "dcl_input_siv", "dcl_input_ps", "dcl_input_ps_sgv",                                       // 96
+    "dcl_input_ps_siv", "dcl_output", "dcl_output_sgv", "dcl_output_siv",                                       // 100
+    "dcl_temps", "dcl_indexableTemp", "dcl_globalFlags", nullptr,                                               // 104
+    "lod", "gather4", "samplepos", "sampleinfo", nullptr,                                                       // 108
+    "hs_decls", "hs_control_point_phase", "hs_fork_phase", "hs_join_phase",                                     // 113
+    "emit_stream", "cut_stream", "emitthencut_stream", "fcall",                                                 // 117
+    "bufinfo", "deriv_rtx_coarse", "deriv_rtx_fine", "deriv_rty_coarse",                                       // 121
+    "deriv_rty_fine", "gather4_c", "gather4_po", "gather4_po_c",                                                // 125
+    "rcp", "f32tof16", "f16tof32", "uaddc", "usubb", "countbits", "firstbit_hi", "firstbit_lo",                 // 129
+    "firstbit_shi", "ubfe", "ibfe", "bfi", "bfrev", "swapc", "dcl_stream", "dcl_function_body",                 // 137
+    "dcl_function_table", "dcl_interface", "dcl_input_control_point_count", "dcl_output_control_point_count",   // 145
+    "dcl_tessellator_domain", "dcl_tessellator_partitioning", "dcl_tessellator_output_primitive",               // 149
+    "dcl_hs_max_tessfactor", "dcl_hs_fork_phase_instance_count", "dcl_hs_join_phase_instance_count",            // 152
+    "dcl_thread_group", "dcl_uav_typed", "dcl_uav_raw", "dcl_uav_structured",                                   // 155
+    "dcl_tgsm_raw", "dcl_tgsm_structured", "dcl_resource_raw", "dcl_resource_structured",                       // 159
+    "ld_uav_typed", "store_uav_typed", "ld_raw", "store_raw", "ld_structured", "store_structured",              // 163
+    "atomic_and", "atomic_or", "atomic_xor", "atomic_cmp_store", "atomic_iadd", "atomic_imax",                  // 169
+    "atomic_imin", "atomic_umax", "atomic_umin", "imm_atomic_alloc", "imm_atomic_consume",                      // 175
+    "imm_atomic_iadd", "imm_atomic_and", "imm_atomic_or", "imm_atomic_xor", "imm_atomic_exch",                  // 180
+    "imm_atomic_cmp_exch", "imm_atomic_imax", "imm_atomic_imin", "imm_atomic_umax", "imm_atomic_umin",          // 185
+    "sync", "dadd", "dmax", "dmin", "dmul", "deq", "dge", "dlt", "dne", "dmov", "dmovc", "dtof", "ftod",        // 190
+    "eval_snapped", "eval_sample_index", "eval_centroid", "dcl_gs_instance_count", "abort", "debug_break",      // 203
+    nullptr, "ddiv", "dfma", "drcp", "msad", "dtoi", "dtou", "itod", "utod",                                    // 209
+};
+
+static const char* const modern_registers[] = {
+    "r", "v", "o", "x", "l", "d", "s", "t", "cb", "icb", "l", "vPrim", "oDepth", "null", "rasterizer", "oMask",
+    "m", "fb", "ft", "fp", "fi", "fo", "vOutputControlPointID", "vForkInstanceID", "vJoinInstanceID", "vicp",
+    "vocp", "vpc", "vDomain", "this", "u", "g", "vThreadID", "vThreadGroupID", "vThreadIDInGroup", "vCoverage",
+    "vThreadIDInGroupFlattened", "vGSInstanceID", "oDepthGE", "oDepthLE", "vCycleCounter", "oStencilRef",
+    "vInnerCoverage",
+};
+
+static const char* const modern_dimensions[] = {
+    "unknown", "buffer", "texture1d", "texture2d", "texture2dms", "texture3d", "texturecube", "texture1darray",
+    "texture2darray", "texture2dmsarray", "texturecubearray", "raw_buffer", "structured_buffer",
+};
+
+// Immediates carry no type, denormal patterns are shown as integers and
+// everything else as a float the way the compiler prints them, -0.0f too
+static void ModernImmediate(std::string& text, uint32_t value)
+{
+    char number[64];
+    uint32_t exponent = (value >> 23) & 0xFF;
+    if (exponent == 0 && value != 0x80000000) {
+        snprintf(number, sizeof(number), "%d", int32_t(value));
+    }
+    else if (exponent == 0xFF) {
+        snprintf(number, sizeof(number), "0x%08x", value);
+    }
+    else {
+        float f;
+        memcpy(&f, &value, sizeof(f));
+        snprintf(number, sizeof(number), "%f", f);
+    }
+    text += number;
+}
+
+static bool ModernReturnType(std::string& text, uint32_t token)
+{
+    static const char* const types[] = { "", "unorm", "snorm", "sint", "uint", "float", "mixed", "double", "continued", "unused" };
+
+    text += '(';
+    for (int i = 0; i < 4; ++i) {
+        uint32_t type = (token >> (i * 4)) & 0xF;
+        if (type >= std::size(types))
+            return false;
+        if (i)
+            text += ',';
+        text += types[type];
+    }
+    text += ')';
+    return true;
+}
+
+static bool ModernOperand(std::string& text, const uint32_t* tokens, size_t& index, size_t end)
+{
+    if (index >= end)
+        return false;
+    uint32_t token = tokens[index++];
+    uint32_t count = token & 0x3;
+    uint32_t selection = (token >> 2) & 0x3;
+    uint32_t type = (token >> 12) & 0xFF;
+    uint32_t dimension = (token >> 20) & 0x3;
+    uint32_t modifier = 0;
+    uint32_t precision = 0;
+    for (bool extended = token >> 31; extended; ) {
+        if (index >= end)
+            return false;
+        uint32_t extension = tokens[index++];
+        if ((extension & 0x3F) == 1) {
+            modifier = (extension >> 6) & 0xFF;
+            precision = (extension >> 14) & 0x7;
+        }
+        extended = extension >> 31;
+    }
+
+    std::string name;
+    if (type == 4 || type == 5) {
+        size_t values = count == 1 ? 1 : count == 2 ? 4 : 0;
+        size_t size = type == 4 ? 1 : 2;
+        if (index + values * size > end)
+            return false;
+        name = type == 4 ? "l(" : "d(";
+        for (size_t i = 0; i < values; ++i) {
+            if (i)
+                name += ", ";
+            if (type == 4) {
+                ModernImmediate(name, tokens[index]);
+            }
+            else {
+                uint64_t bits = tokens[index] | (uint64_t(tokens[index + 1]) << 32);
+                double value;
+                memcpy(&value, &bits, sizeof(value));
+                char number[64];
+                snprintf(number, sizeof(number), "%f", value);
+                name += number;
+            }
+            index += size;
+        }
+        name += ')';
+    }
+    else {
+        if (type >= std::size(modern_registers))
+            return false;
+        name = modern_registers[type];
+
+        // Vertex arrays and the immediate constant buffer bracket every index
+        bool bracketed = type == 9 || type == 25 || type == 26 || (type == 1 && dimension == 2);
+        for (uint32_t i = 0; i < dimension; ++i) {
+            uint32_t representation = (token >> (22 + i * 3)) & 0x7;
+            uint64_t value = 0;
+            switch (representation) {
+            case 0:
+            case 3:
+                if (index >= end)
+                    return false;
+                value = tokens[index++];
+                break;
+            case 1:
+            case 4:
+                if (index + 2 > end)
+                    return false;
+                value = (uint64_t(tokens[index]) << 32) | tokens[index + 1];
+                index += 2;
+                break;
+            case 2:
+                break;
+            default:
+                return false;
+            }
+            std::string number = std::to_string(value);
+            if (representation >= 2) {
+                std::string address;
+                if (ModernOperand(address, tokens, index, end) == false)
+                    return false;
+                name += '[' + address + " + " + number + ']';
+            }
+            else if (i == 0 && bracketed == false) {
+                name += number;
+            }
+            else {
+                name += '[' + number + ']';
+            }
+        }
+
+        if (count == 2) {
+            switch (selection) {
+            case 0:
+                if ((token >> 4) & 0xF) {
+                    name += '.';
+                    for (int i = 0; i < 4; ++i) {
+                        if (token & (1 << (4 + i)))
+                            name += components[i];
+                    }
+                }
+                break;
+            case 1:
+                name += '.';
+                for (int i = 0; i < 4; ++i)
+                    name += components[(token >> (4 + i * 2)) & 0x3];
+                break;
+            case 2:
+                name += '.';
+                name += components[(token >> 4) & 0x3];
+                break;
+            default:
+                return false;
+            }
+        }
+    }
+
+    switch (modifier) {
+    case 0:                                 break;
+    case 1: name = '-' + name;              break;
+    case 2: name = '|' + name + '|';        break;
+    case 3: name = "-|" + name + '|';       break;
+    default:
+        return false;
+    }
+    switch (precision) {
+    case 1: name += " {min16f}";            break;
+    case 2: name += " {min2_8f}";           break;
+    case 4: name += " {min16i}";            break;
+    case 5: name += " {min16u}";            break;
+    default:                                break;
+    }
+
+    text += name;
+    return true;
+}
+
+static bool ModernListing(Sink& sink, Container::Span chunk)
+{
+    static const char* const programs[] = { "ps", "vs", "gs", "hs", "ds", "cs" };
+    static const char* const interpolations[] = {
+        "", "constant", "linear", "linear centroid", "linear noperspective",
+        "linear noperspective centroid", "linear sample", "linear noperspective sample",
+    };
+    static const char* const names[] = {
+        "undefined", "position", "clip_distance", "cull_distance", "rendertarget_array_index",
+        "viewport_array_index", "vertex_id", "primitive_id", "instance_id", "is_front_face", "sampleIndex",
+        "finalQuadUeq0EdgeTessFactor", "finalQuadVeq0EdgeTessFactor", "finalQuadUeq1EdgeTessFactor",
+        "finalQuadVeq1EdgeTessFactor", "finalQuadUInsideTessFactor", "finalQuadVInsideTessFactor",
+        "finalTriUeq0EdgeTessFactor", "finalTriVeq0EdgeTessFactor", "finalTriWeq0EdgeTessFactor",
+        "finalTriInsideTessFactor", "finalLineDetailTessFactor", "finalLineDensityTessFactor",
+    };
+
+    const uint32_t* tokens = (const uint32_t*)chunk.data;
+    size_t count = chunk.size / sizeof(uint32_t);
+    if (count < 2)
+        return false;
+    uint32_t program = tokens[0] >> 16;
+    if (program >= std::size(programs) || tokens[1] < 2 || tokens[1] > count)
+        return false;
+    count = tokens[1];
+    sink.Print("%s_%d_%d\n", programs[program], (tokens[0] >> 4) & 0xF, tokens[0] & 0xF);
+
+    size_t index = 2;
+    while (index < count) {
+        uint32_t token = tokens[index];
+        uint32_t opcode = token & 0x7FF;
+        size_t length = (token >> 24) & 0x7F;
+        if (opcode == 53 && index + 1 < count)
+            length = tokens[index + 1];
+        if (length == 0 || length > count - index)
+            return false;
+        size_t end = index + length;
+
+        // Only the immediate constant buffer of the custom data blocks is
+        // part of the listing
+        if (opcode == 53) {
+            if ((token >> 11) == 3) {
+                sink.Write("dcl_immediateConstantBuffer { ");
+                for (size_t i = index + 2; i < end; i += 4) {
+                    if (i != index + 2)
+                        sink.Write(",\n                              ");
+                    std::string row = "{ ";
+                    for (size_t j = i; j < std::min(i + 4, end); ++j) {
+                        if (j != i)
+                            row += ", ";
+                        ModernImmediate(row, tokens[j]);
+                    }
+                    row += '}';
+                    sink.Write(row.c_str());
+                }
+                sink.Write(" }\n");
+            }
+            index = end;
+            continue;
+        }
+        if (opcode >= std::size(modern_opcodes) || modern_opcodes[opcode] == nullptr)
+            return false;
+
+        size_t p = index + 1;
+        std::string offsets;
+        std::string dimension;
+        std::string returns;
+        for (bool extended = token >> 31; extended; ) {
+            if (p >= end)
+                return false;
+            uint32_t extension = tokens[p++];
+            switch (extension & 0x3F) {
+            case 1: {
+                char text[64];
+                snprintf(text, sizeof(text), "(%d,%d,%d)", int32_t(extension << 19) >> 28, int32_t(extension << 15) >> 28, int32_t(extension << 11) >> 28);
+                offsets = text;
+                break;
+            }
+            case 2: {
+                uint32_t resource = (extension >> 6) & 0x1F;
+                if (resource >= std::size(modern_dimensions))
+                    return false;
+                dimension = '(';
+                dimension += modern_dimensions[resource];
+                if (resource == 12)
+                    dimension += ", stride=" + std::to_string((extension >> 11) & 0xFFF);
+                dimension += ')';
+                break;
+            }
+            case 3:
+                if (ModernReturnType(returns, extension >> 6) == false)
+                    return false;
+                break;
+            default:
+                break;
+            }
+            extended = extension >> 31;
+        }
+
+        std::string name = modern_opcodes[opcode];
+        std::string operands;
+        auto operand = [&]() {
+            if (operands.empty() == false)
+                operands += ", ";
+            return ModernOperand(operands, tokens, p, end);
+        };
+        auto value = [&](uint32_t& result) {
+            if (p >= end)
+                return false;
+            result = tokens[p++];
+            return true;
+        };
+
+        uint32_t number = 0;
+        bool decoded = true;
+        switch (opcode) {
+        case 3:
+        case 5:
+        case 8:
+        case 13:
+        case 31:
+        case 63:
+            name += (token & (1 << 18)) ? "_nz" : "_z";
+            break;
+        case 61:
+            name += ((token >> 11) & 0x3) == 1 ? "_rcpFloat" : ((token >> 11) & 0x3) == 2 ? "_uint" : "";
+            break;
+        case 111:
+            name += (token & (1 << 11)) ? "_uint" : "";
+            break;
+        case 190:
+            name += (token & (1 << 14)) ? "_uglobal" : "";
+            name += (token & (1 << 13)) ? "_ugroup" : "";
+            name += (token & (1 << 12)) ? "_g" : "";
+            name += (token & (1 << 11)) ? "_t" : "";
+            break;
+        case 88: {
+            uint32_t resource = (token >> 11) & 0x1F;
+            if (resource >= std::size(modern_dimensions))
+                return false;
+            name += '_';
+            name += modern_dimensions[resource];
+            if (resource == 4 || resource == 9)
+                name += '(' + std::to_string((token >> 16) & 0x7F) + ')';
+            std::string type;
+            decoded = operand() && value(number) && ModernReturnType(type, number);
+            operands = type + ' ' + operands;
+            break;
+        }
+        case 89:
+            decoded = operand();
+            operands += (token & (1 << 11)) ? ", dynamicIndexed" : ", immediateIndexed";
+            break;
+        case 90: {
+            static const char* const modes[] = { "mode_default", "mode_comparison", "mode_mono" };
+            uint32_t mode = (token >> 11) & 0xF;
+            if (mode >= std::size(modes))
+                return false;
+            decoded = operand();
+            operands += ", ";
+            operands += modes[mode];
+            break;
+        }
+        case 91:
+        case 159:
+        case 162:
+            decoded = operand() && value(number);
+            operands += (opcode == 91 ? " " : ", ") + std::to_string(number);
+            break;
+        case 160:
+        case 158: {
+            if (opcode == 158) {
+                name += (token & (1 << 16)) ? "_glc" : "";
+                name += (token & (1 << 23)) ? "_opc" : "";
+            }
+            uint32_t stride = 0;
+            decoded = operand() && value(stride);
+            operands += ", " + std::to_string(stride);
+            if (opcode == 160) {
+                decoded = decoded && value(number);
+                operands += ", " + std::to_string(number);
+            }
+            break;
+        }
+        case 92: {
+            static const char* const topologies[] = { "undefined", "pointlist", "", "linestrip", "", "trianglestrip" };
+            uint32_t topology = (token >> 11) & 0x7F;
+            if (topology >= std::size(topologies))
+                return false;
+            operands = topologies[topology];
+            break;
+        }
+        case 93: {
+            static const char* const primitives[] = { "undefined", "point", "line", "triangle", "", "", "lineadj", "triangleadj" };
+            uint32_t primitive = (token >> 11) & 0x3F;
+            if (primitive >= std::size(primitives))
+                operands = "patch" + std::to_string(primitive - 7);
+            else
+                operands = primitives[primitive];
+            break;
+        }
+        case 94:
+        case 104:
+        case 153:
+        case 154:
+        case 206:
+            decoded = value(number);
+            operands = std::to_string(number);
+            break;
+        case 96:
+        case 97:
+        case 99:
+        case 100:
+        case 102:
+        case 103:
+        case 98: {
+            if (opcode >= 98 && opcode <= 100) {
+                uint32_t interpolation = (token >> 11) & 0xF;
+                if (interpolation >= std::size(interpolations))
+                    return false;
+                operands = interpolations[interpolation];
+                if (operands.empty() == false)
+                    operands += ' ';
+                std::string target;
+                decoded = ModernOperand(target, tokens, p, end);
+                operands += target;
+            }
+            else {
+                decoded = operand();
+            }
+            if (opcode != 98) {
+                decoded = decoded && value(number);
+                operands += ", ";
+                operands += number < std::size(names) ? names[number] : std::to_string(number);
+            }
+            break;
+        }
+        case 105: {
+            uint32_t reg = 0;
+            uint32_t size = 0;
+            decoded = value(reg) && value(size) && value(number);
+            operands = 'x' + std::to_string(reg) + '[' + std::to_string(size) + "], " + std::to_string(number);
+            break;
+        }
+        case 106: {
+            static const char* const flags[] = {
+                "refactoringAllowed", "enableDoublePrecisionFloatOps", "forceEarlyDepthStencil",
+                "enableRawAndStructuredBuffers", "skipOptimization", "enableMinimumPrecision",
+                "enable11_1DoubleExtensions", "enable11_1ShaderExtensions",
+            };
+            for (int i = 0; i < (int)std::size(flags); ++i) {
+                if (token & (1 << (11 + i))) {
+                    if (operands.empty() == false)
+                        operands += " | ";
+                    operands += flags[i];
+                }
+            }
+            break;
+        }
+        case 144:
+            decoded = value(number);
+            operands = "fb" + std::to_string(number);
+            break;
+        case 145: {
+            uint32_t size = 0;
+            decoded = value(number) && value(size);
+            operands = "ft" + std::to_string(number) + " = {";
+            for (uint32_t i = 0; decoded && i < size; ++i) {
+                uint32_t body = 0;
+                decoded = value(body);
+                operands += (i ? ", fb" : "fb") + std::to_string(body);
+            }
+            operands += '}';
+            break;
+        }
+        case 146:
+            decoded = value(number);
+            operands = "fp" + std::to_string(number);
+            p = end;
+            break;
+        case 147:
+        case 148:
+            operands = std::to_string((token >> 11) & 0x3F);
+            break;
+        case 149: {
+            static const char* const domains[] = { "domain_undefined", "domain_isoline", "domain_tri", "domain_quad" };
+            operands = domains[(token >> 11) & 0x3];
+            break;
+        }
+        case 150: {
+            static const char* const partitionings[] = {
+                "partitioning_undefined", "partitioning_integer", "partitioning_pow2",
+                "partitioning_fractional_odd", "partitioning_fractional_even",
+            };
+            uint32_t partitioning = (token >> 11) & 0x7;
+            if (partitioning >= std::size(partitionings))
+                return false;
+            operands = partitionings[partitioning];
+            break;
+        }
+        case 151: {
+            static const char* const outputs[] = {
+                "output_undefined", "output_point", "output_line", "output_triangle_cw", "output_triangle_ccw",
+            };
+            uint32_t output = (token >> 11) & 0x7;
+            if (output >= std::size(outputs))
+                return false;
+            operands = outputs[output];
+            break;
+        }
+        case 152:
+            decoded = value(number);
+            operands = "l(";
+            ModernImmediate(operands, number);
+            operands += ')';
+            break;
+        case 155: {
+            uint32_t y = 0;
+            uint32_t z = 0;
+            decoded = value(number) && value(y) && value(z);
+            operands = std::to_string(number) + ", " + std::to_string(y) + ", " + std::to_string(z);
+            break;
+        }
+        case 156: {
+            uint32_t resource = (token >> 11) & 0x1F;
+            if (resource >= std::size(modern_dimensions))
+                return false;
+            name += '_';
+            name += modern_dimensions[resource];
+            name += (token & (1 << 16)) ? "_glc" : "";
+            std::string type;
+            decoded = operand() && value(number) && ModernReturnType(type, number);
+            operands = type + ' ' + operands;
+            break;
+        }
+        case 157:
+            name += (token & (1 << 16)) ? "_glc" : "";
+            break;
+        default:
+            if (opcode < 88 || (opcode > 107 && opcode < 143) || (opcode > 162 && opcode != 206))
+                name += (token & (1 << 13)) ? "_sat" : "";
+            break;
+        }
+        if (decoded == false)
+            return false;
+
+        if (offsets.empty() == false)
+            name += "_aoffimmi";
+        if (dimension.empty() == false)
+            name += "_indexable";
+        name += offsets + dimension + returns;
+
+        while (p < end) {
+            if (operand() == false)
+                return false;
+        }
+
+        sink.Print("%s%s%s\n", name.c_str(), operands.empty() ? "" : " ", operands.c_str());
+        index = end;
+    }
+
+    return true;
+}
+
+// The comments above a listing come from RDEF and the signature chunks
+static void ModernHeader(Sink& sink, Container::Span binary)
+{
+    Container::Span rdef = Container::Find(binary, Container::Format::DXBC, "RDEF");
+    std::string_view creator = String(rdef, rdef.Word(24));
+    sink.Write("//\n");
+    sink.Print("// Generated by %.*s\n", int(creator.size()), creator.data());
+    sink.Write("//\n//\n");
+
+    uint32_t bindings = rdef.Word(8);
+    if (bindings) {
+        static const char* const types[] = {
+            "cbuffer", "tbuffer", "texture", "sampler", "UAV", "texture", "UAV", "texture", "UAV", "UAV", "UAV", "UAV",
+        };
+        static const char* const formats[] = { "NA", "unorm", "snorm", "sint", "uint", "float", "mixed", "double" };
+        static const char* const dimensions[] = {
+            "NA", "buf", "1d", "1darray", "2d", "2darray", "2dMS", "2dMSarray", "3d", "cube", "cubearray", "buf",
+        };
+
+        uint32_t target = rdef.Word(16);
+        size_t stride = (target & 0xFFFF) == 0x0501 ? 40 : 32;
+        uint32_t offset = rdef.Word(12);
+        sink.Write("// Resource Bindings:\n//\n");
+        sink.Write("// Name                                 Type  Format         Dim Slot Elements\n");
+        sink.Write("// ------------------------------ ---------- ------- ----------- ---- --------\n");
+        for (uint32_t i = 0; i < bindings; ++i) {
+            size_t binding = offset + i * stride;
+            if (!rdef.Sub(binding, stride))
+                break;
+            std::string_view name = String(rdef, rdef.Word(binding));
+            uint32_t type = rdef.Word(binding + 4);
+            uint32_t format = rdef.Word(binding + 8);
+            uint32_t dimension = rdef.Word(binding + 12);
+            uint32_t slot = rdef.Word(binding + 20);
+            uint32_t elements = rdef.Word(binding + 24);
+            uint32_t flags = rdef.Word(binding + 28);
+            std::string format_text = format < std::size(formats) ? formats[format] : "NA";
+            if (format >= 1 && format <= 7 && (flags & 0xC))
+                format_text += std::to_string(((flags >> 2) & 0x3) + 1);
+            if (type == 5 || type == 6 || type == 9 || type == 10 || type == 11)
+                format_text = "struct";
+            if (type == 7 || type == 8)
+                format_text = "byte";
+            sink.Print("// %-30.*s %10s %7s %11s %4d %8d\n", int(name.size()), name.data(),
+                       type < std::size(types) ? types[type] : "?", format_text.c_str(),
+                       dimension < std::size(dimensions) ? dimensions[dimension] : "?", slot, elements);
+        }
+        sink.Write("//\n//\n//\n");
+    }
+
+    static const struct {
+        const char* tag;
+        const char* title;
+        size_t stride;
+        bool output;
+    } signatures[] = {
+        { "ISGN", "Input signature",            24, false },
+        { "PCSG", "Patch Constant signature",   24, true },
+        { "OSGN", "Output signature",           24, true },
+        { "OSG5", "Output signature",           28, true },
+    };
+    for (auto& signature : signatures) {
+        Container::Span chunk = Container::Find(binary, Container::Format::DXBC, signature.tag);
+        if (!chunk)
+            continue;
+
+        static const char* const values[] = {
+            "NONE", "POS", "CLIPDST", "CULLDST", "RTINDEX", "VPINDEX", "VERTID", "PRIMID", "INSTID", "FFACE",
+            "SAMPLE", "QUADEDGE", "QUADEDGE", "QUADEDGE", "QUADEDGE", "QUADINT", "QUADINT", "TRIEDGE",
+            "TRIEDGE", "TRIEDGE", "TRIINT", "LINEDET", "LINEDEN",
+        };
+        static const char* const extras[] = { "TARGET", "DEPTH", "COVERAGE", "DEPTHGE", "DEPTHLE" };
+        static const char* const formats[] = { "", "uint", "int", "float" };
+        auto mask = [](uint32_t bits) {
+            std::string text = "    ";
+            for (int i = 0; i < 4; ++i) {
+                if (bits & (1 << i))
+                    text[i] = components[i];
+            }
+            return text;
+        };
+
+        sink.Print("// %s:\n//\n", signature.title);
+        sink.Write("// Name                 Index   Mask Register SysValue Format   Used\n");
+        sink.Write("// -------------------- ----- ------ -------- -------- ------ ------\n");
+        uint32_t elements = chunk.Word(0);
+        size_t first = signature.stride == 28 ? 4 : 0;
+        for (uint32_t i = 0; i < elements; ++i) {
+            size_t element = 8 + i * signature.stride + first;
+            if (!chunk.Sub(element, 24))
+                break;
+            std::string_view name = String(chunk, chunk.Word(element));
+            uint32_t semantic = chunk.Word(element + 4);
+            uint32_t value = chunk.Word(element + 8);
+            uint32_t format = chunk.Word(element + 12);
+            uint32_t reg = chunk.Word(element + 16);
+            uint32_t bits = chunk.Word(element + 20) & 0xFF;
+            uint32_t used = (chunk.Word(element + 20) >> 8) & 0xFF;
+            if (signature.output)
+                used = bits & ~used;
+            const char* value_text = value < std::size(values) ? values[value] : (value >= 64 && value - 64 < std::size(extras)) ? extras[value - 64] : "?";
+            sink.Print("// %-20.*s %5d %6s %8d %8s %6s %6s\n", int(name.size()), name.data(), semantic,
+                       mask(bits).c_str(), reg, value_text, format < std::size(formats) ? formats[format] : "?",
+                       mask(used).c_str());
+        }
+        sink.Write("//\n");
+    }
+}
+
+bool Disassemble(Sink& sink, const void* binary, size_t size)
+{
+    Container::Span span(binary, size);
+    if (Container::Identify(span) == Container::Format::DXBC) {
+        Container::Span shader = Container::Find(span, Container::Format::DXBC, "SHEX");
+        if (!shader)
+            shader = Container::Find(span, Container::Format::DXBC, "SHDR");
+        if (!shader)
+            return false;
+        ModernHeader(sink, span);
+        if (ModernListing(sink, shader) == false)
+            return false;
+        Container::Span stat = Container::Find(span, Container::Format::DXBC, "STAT");
+        if (stat)
+            sink.Print("// Approximately %d instruction slots used\n", stat.Word(0));
+        return true;
+    }
+
+    uint32_t version = span.Word(0);
+    if (size % sizeof(uint32_t) || ((version >> 16) != 0xFFFE && (version >> 16) != 0xFFFF))
+        return false;
+    return LegacyListing(sink, (const uint32_t*)binary, size / sizeof(uint32_t));
+}
+
+};  // namespace D3DDisassembler
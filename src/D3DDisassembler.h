@@ -0,0 +1,16 @@
+#pragma once
+
+struct Sink;
+
+// Native listing of Direct3D shader bytecode
+//
+// Reads the token stream of vs/ps 1.x - 3.0 and the SHDR/SHEX chunk of a
+// DXBC container and writes the listing D3DDisassemble would produce, with
+// the header comments taken from the constant table, RDEF and signatures.
+// Returns false on anything it does not know so the caller can fall back to
+// the emulated disassembler.
+namespace D3DDisassembler {
+
+bool Disassemble(Sink& sink, const void* binary, size_t size);
+
+};  // namespace D3DDisassembler
@@ -0,0 +1,515 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "LogFile.h"
+#include "Logger.h"
+
+namespace LogFile {
+
+// Layout
+//
+//   header : magic, version
+//   blocks : raw size, packed size, packed records
+//   record : previous node, first block, block count, line counts, name
+//   index  : job count, jobs (name, first block, block count, line counts)
+//   footer : last node offset, magic
+//
+// A block never spans two jobs, so a job is read back from its first block
+// without touching the rest of the file. Every finished job appends one
+// fixed size record behind its blocks, the records chain back to the index
+// written when the file was created or last closed, which then holds every
+// job again. The footer is rewritten after every block, so the file is
+// complete up to the last finished job.
+//
+// Lines are picked by the job id the logger tagged them with, output of
+// other jobs running at the same time stays out of the current one.
+static const uint32_t file_magic = 'SCLG';
+static const uint32_t index_magic = 'SCLI';
+static const uint32_t record_magic = 'SCLR';
+static const uint32_t file_version = 2;
+static const size_t block_size = 64 * 1024;
+static const size_t name_size = 128;
+static const size_t footer_size = sizeof(uint64_t) + sizeof(uint32_t);
+
+static FILE* file;
+static std::vector<Job> jobs;
+static Job job;
+static uint32_t job_id;
+static bool active;
+static std::string block;
+static uint64_t end;
+static uint64_t last;
+static uint32_t recorded;
+static size_t cursors[2];
+
+struct Packer {
+    std::string data;
+    template<typename T>
+    void Value(T value) {
+        data.append((char*)&value, sizeof(T));
+    }
+    void String(const std::string& string) {
+        Value(uint32_t(string.size()));
+        data.append(string);
+    }
+};
+
+struct Unpacker {
+    const char* data;
+    const char* end;
+    bool failed = false;
+    template<typename T>
+    T Value() {
+        T value = {};
+        if (size_t(end - data) < sizeof(T)) {
+            failed = true;
+            return value;
+        }
+        memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return value;
+    }
+    std::string String() {
+        uint32_t size = Value<uint32_t>();
+        if (size_t(end - data) < size) {
+            failed = true;
+            return std::string();
+        }
+        std::string string(data, size);
+        data += size;
+        return string;
+    }
+};
+
+// LZ77 with an LZ4 style token : literal count and match length in one byte,
+// longer counts continue in bytes of 255, matches reach back 64KB
+static void Compress(const std::string& input, std::string& output)
+{
+    const uint8_t* source = (const uint8_t*)input.data();
+    size_t size = input.size();
+    uint32_t table[4096] = {};
+    size_t anchor = 0;
+
+    auto count = [&](size_t value) {
+        for (; value >= 255; value -= 255)
+            output += char(255);
+        output += char(value);
+    };
+    auto sequence = [&](size_t literal_end, size_t match, size_t distance) {
+        size_t literals = literal_end - anchor;
+        size_t extra = match ? match - 4 : 0;
+        output += char((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(extra, 15));
+        if (literals >= 15)
+            count(literals - 15);
+        output.append(input, anchor, literals);
+        if (match == 0)
+            return;
+        output += char(distance);
+        output += char(distance >> 8);
+        if (extra >= 15)
+            count(extra - 15);
+    };
+
+    for (size_t i = 0; i + 4 <= size; ) {
+        uint32_t value;
+        memcpy(&value, source + i, 4);
+        uint32_t hash = (value * 2654435761u) >> 20;
+        size_t candidate = table[hash];
+        table[hash] = uint32_t(i + 1);
+        if (candidate == 0 || i - (candidate - 1) > 65535 || memcmp(source + candidate - 1, source + i, 4) != 0) {
+            i++;
+            continue;
+        }
+        size_t from = candidate - 1;
+        size_t match = 4;
+        while (i + match < size && source[from + match] == source[i + match])
+            match++;
+        sequence(i, match, i - from);
+        i += match;
+        anchor = i;
+    }
+
+    // The last sequence only carries literals
+    sequence(size, 0, 0);
+}
+
+static bool Decompress(const char* data, size_t size, size_t raw_size, std::string& output)
+{
+    const uint8_t* input = (const uint8_t*)data;
+    const uint8_t* input_end = input + size;
+    output.clear();
+    output.reserve(raw_size);
+
+    auto count = [&](size_t& value) {
+        uint8_t byte = 255;
+        while (byte == 255) {
+            if (input == input_end)
+                return false;
+            byte = *input++;
+            value += byte;
+        }
+        return true;
+    };
+
+    while (input < input_end) {
+        uint8_t token = *input++;
+        size_t literals = token >> 4;
+        if (literals == 15 && count(literals) == false)
+            return false;
+        if (size_t(input_end - input) < literals || output.size() + literals > raw_size)
+            return false;
+        output.append((const char*)input, literals);
+        input += literals;
+        if (input == input_end)
+            break;
+
+        if (input_end - input < 2)
+            return false;
+        size_t distance = input[0] | (input[1] << 8);
+        input += 2;
+        size_t match = token & 15;
+        if (match == 15 && count(match) == false)
+            return false;
+        match += 4;
+        if (distance == 0 || distance > output.size() || output.size() + match > raw_size)
+            return false;
+
+        // Matches may overlap what they produce
+        size_t from = output.size() - distance;
+        for (size_t i = 0; i < match; ++i) {
+            output += output[from + i];
+        }
+    }
+    return output.size() == raw_size;
+}
+
+static void WriteFooter()
+{
+    Packer packer;
+    packer.Value(last);
+    packer.Value(file_magic);
+    fseeko(file, off_t(end), SEEK_SET);
+    fwrite(packer.data.data(), 1, packer.data.size(), file);
+    fflush(file);
+    ftruncate(fileno(file), off_t(end + packer.data.size()));
+}
+
+static void Flush()
+{
+    if (file == nullptr || block.empty())
+        return;
+
+    std::string packed;
+    Compress(block, packed);
+    Packer packer;
+    packer.Value(uint32_t(block.size()));
+    packer.Value(uint32_t(packed.size()));
+    packer.data += packed;
+    fseeko(file, off_t(end), SEEK_SET);
+    fwrite(packer.data.data(), 1, packer.data.size(), file);
+    end += packer.data.size();
+    job.blocks++;
+    block.clear();
+    WriteFooter();
+}
+
+static void WriteIndex()
+{
+    Packer packer;
+    packer.Value(index_magic);
+    packer.Value(uint32_t(jobs.size()));
+    for (auto& job : jobs) {
+        packer.String(job.name);
+        packer.Value(job.offset);
+        packer.Value(job.blocks);
+        packer.Value(job.lines[CONSOLE]);
+        packer.Value(job.lines[SYSTEM]);
+    }
+    fseeko(file, off_t(end), SEEK_SET);
+    fwrite(packer.data.data(), 1, packer.data.size(), file);
+    last = end;
+    end += packer.data.size();
+    recorded = 0;
+    WriteFooter();
+}
+
+static void WriteRecord(const Job& job)
+{
+    char name[name_size] = {};
+    memcpy(name, job.name.data(), std::min(job.name.size(), name_size));
+
+    Packer packer;
+    packer.Value(record_magic);
+    packer.Value(last);
+    packer.Value(job.offset);
+    packer.Value(job.blocks);
+    packer.Value(job.lines[CONSOLE]);
+    packer.Value(job.lines[SYSTEM]);
+    packer.data.append(name, name_size);
+    fseeko(file, off_t(end), SEEK_SET);
+    fwrite(packer.data.data(), 1, packer.data.size(), file);
+    last = end;
+    end += packer.data.size();
+    recorded++;
+    WriteFooter();
+}
+
+static bool Pending(const LogBuffer& log)
+{
+    return log.Size() && log.Line(log.Size() - 1)[0] == 0;
+}
+
+static void Write(int index, bool all)
+{
+    // The last line of a log may still be growing until the job ends,
+    // an empty one belongs to whatever is written next
+    auto& log = logs[index];
+    size_t total = log.Total();
+    if (log.Size() && (all == false || Pending(log)))
+        total--;
+    size_t& cursor = cursors[index];
+    cursor = std::max(cursor, log.Dropped());
+    for (; cursor < total; ++cursor) {
+        if (job_id && log.Job(cursor - log.Dropped()) != job_id)
+            continue;
+        const char* line = log.Line(cursor - log.Dropped());
+        size_t length = strlen(line);
+        block += char(index);
+        for (size_t value = length; ; value >>= 7) {
+            block += char((value & 0x7F) | (value >= 0x80 ? 0x80 : 0));
+            if (value < 0x80)
+                break;
+        }
+        block.append(line, length);
+        job.lines[index]++;
+        if (block.size() >= block_size) {
+            Flush();
+        }
+    }
+}
+
+bool Open(const std::string& path)
+{
+    Close();
+
+    // Jobs of earlier sessions are kept, new blocks go where the footer was
+    Reader reader;
+    if (reader.Open(path)) {
+        jobs = reader.jobs;
+        last = reader.index_offset;
+        end = reader.end_offset;
+        recorded = 0;
+        reader.Close();
+        file = fopen(path.c_str(), "r+b");
+    }
+    else {
+        // A file which is not a log is moved aside instead of being overwritten
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && st.st_size) {
+            std::string aside = path + ".old";
+            bool moved = rename(path.c_str(), aside.c_str()) == 0;
+            Logger<SYSTEM>("Log : %s (%s)\n", moved ? "File is damaged, moved aside" : "File is damaged", moved ? aside.c_str() : path.c_str());
+            if (moved == false)
+                return false;
+        }
+    }
+    if (file == nullptr) {
+        jobs.clear();
+        file = fopen(path.c_str(), "w+b");
+        if (file == nullptr)
+            return false;
+        Packer packer;
+        packer.Value(file_magic);
+        packer.Value(file_version);
+        fwrite(packer.data.data(), 1, packer.data.size(), file);
+        end = packer.data.size();
+        WriteIndex();
+    }
+    return true;
+}
+
+void Close()
+{
+    if (file == nullptr)
+        return;
+    End();
+    if (recorded)
+        WriteIndex();
+    fclose(file);
+    file = nullptr;
+    jobs.clear();
+}
+
+bool Opened()
+{
+    return file != nullptr;
+}
+
+void Begin(const std::string& name)
+{
+    if (file == nullptr)
+        return;
+    End();
+    job = { name, end, 0, { 0, 0 } };
+    job_id = logs_job;
+    active = true;
+    cursors[CONSOLE] = logs[CONSOLE].Total() - (Pending(logs[CONSOLE]) ? 1 : 0);
+    cursors[SYSTEM] = logs[SYSTEM].Total() - (Pending(logs[SYSTEM]) ? 1 : 0);
+}
+
+void Sync()
+{
+    if (file == nullptr || active == false)
+        return;
+    Write(CONSOLE, false);
+    Write(SYSTEM, false);
+}
+
+void End()
+{
+    if (file == nullptr || active == false)
+        return;
+    Write(CONSOLE, true);
+    Write(SYSTEM, true);
+    Flush();
+    jobs.push_back(job);
+    active = false;
+    WriteRecord(job);
+}
+
+Reader::~Reader()
+{
+    Close();
+}
+
+bool Reader::Open(const std::string& path)
+{
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    size = st.st_size;
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        size = 0;
+        return false;
+    }
+    data = (char*)map;
+
+    Unpacker header = { data, data + size };
+    bool valid = header.Value<uint32_t>() == file_magic &&
+                 header.Value<uint32_t>() == file_version &&
+                 size >= sizeof(uint32_t) * 2 + footer_size;
+
+    uint64_t footer_offset = size - footer_size;
+    Unpacker footer = { data + footer_offset, data + size };
+    uint64_t index = valid ? footer.Value<uint64_t>() : 0;
+    valid = valid && footer.Value<uint32_t>() == file_magic && index < footer_offset;
+
+    // Records are walked back to the index, each one lies before the one after it
+    std::vector<Job> records;
+    uint64_t node = index;
+    Unpacker unpacker = { data + node, data + footer_offset };
+    while (valid && unpacker.failed == false) {
+        uint32_t magic = unpacker.Value<uint32_t>();
+        if (magic == index_magic)
+            break;
+        if (magic != record_magic) {
+            valid = false;
+            break;
+        }
+        uint64_t previous = unpacker.Value<uint64_t>();
+        Job job;
+        job.offset = unpacker.Value<uint64_t>();
+        job.blocks = unpacker.Value<uint32_t>();
+        job.lines[CONSOLE] = unpacker.Value<uint32_t>();
+        job.lines[SYSTEM] = unpacker.Value<uint32_t>();
+        if (unpacker.failed || size_t(unpacker.end - unpacker.data) < name_size || previous >= node) {
+            valid = false;
+            break;
+        }
+        job.name.assign(unpacker.data, strnlen(unpacker.data, name_size));
+        records.push_back(job);
+        node = previous;
+        unpacker.data = data + node;
+    }
+    uint32_t job_count = valid ? unpacker.Value<uint32_t>() : 0;
+    for (uint32_t i = 0; i < job_count && unpacker.failed == false; ++i) {
+        Job job;
+        job.name = unpacker.String();
+        job.offset = unpacker.Value<uint64_t>();
+        job.blocks = unpacker.Value<uint32_t>();
+        job.lines[CONSOLE] = unpacker.Value<uint32_t>();
+        job.lines[SYSTEM] = unpacker.Value<uint32_t>();
+        jobs.push_back(job);
+    }
+    if (valid == false || unpacker.failed) {
+        Close();
+        return false;
+    }
+    jobs.insert(jobs.end(), records.rbegin(), records.rend());
+    index_offset = index;
+    end_offset = footer_offset;
+    return true;
+}
+
+void Reader::Close()
+{
+    if (data) {
+        munmap((void*)data, size);
+    }
+    data = nullptr;
+    size = 0;
+    jobs.clear();
+    index_offset = 0;
+    end_offset = 0;
+}
+
+bool Reader::Read(size_t index, std::vector<std::string> lines[2]) const
+{
+    if (index >= jobs.size())
+        return false;
+
+    auto& job = jobs[index];
+    Unpacker unpacker = { data + std::min<uint64_t>(job.offset, size), data + size };
+    std::string raw;
+    for (uint32_t i = 0; i < job.blocks; ++i) {
+        uint32_t raw_size = unpacker.Value<uint32_t>();
+        uint32_t packed_size = unpacker.Value<uint32_t>();
+        if (unpacker.failed || size_t(unpacker.end - unpacker.data) < packed_size)
+            return false;
+        if (Decompress(unpacker.data, packed_size, raw_size, raw) == false)
+            return false;
+        unpacker.data += packed_size;
+
+        for (size_t j = 0; j < raw.size(); ) {
+            int stream = raw[j++] & 1;
+            size_t length = 0;
+            for (int shift = 0; j < raw.size(); shift += 7) {
+                uint8_t byte = raw[j++];
+                length |= size_t(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                    break;
+            }
+            length = std::min(length, raw.size() - j);
+            lines[stream].emplace_back(raw, j, length);
+            j += length;
+        }
+    }
+    return true;
+}
+
+};  // namespace LogFile
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace LogFile {
+
+struct Job {
+    std::string name;
+    uint64_t offset;
+    uint32_t blocks;
+    uint32_t lines[2];
+};
+
+struct Reader {
+    ~Reader();
+    bool Open(const std::string& path);
+    void Close();
+    bool Read(size_t job, std::vector<std::string> lines[2]) const;
+
+    std::vector<Job> jobs;
+    uint64_t index_offset = 0;
+    uint64_t end_offset = 0;
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+bool Open(const std::string& path);
+void Close();
+bool Opened();
+void Begin(const std::string& name);
+void Sync();
+void End();
+
+};  // namespace LogFile
@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <string_view>
+#include <thread>
+#include "Container.h"
 #include "Logger.h"
 #include "ShaderCompiler.h"
+#include "Sink.h"
+#include "Timeline.h"
 #include "VirtualMachine.h"
 #include "../mine/syscall/allocator.h"
 #include "../mine/x86/x86_i386.h"
@@ -7,8 +13,9 @@
 #include "../mine/x86/x86_register.inl"
 
 extern "C" {
-    int mesa_fprintf(FILE* fp, const char* format, ...);
-    void mesa_cleanup();
+    FILE* mesa_context_create(void* sink, unsigned debug);
+    void mesa_context_destroy(FILE* fp);
+    unsigned mesa_debug(FILE* fp);
 #   include "../disassembler/utgard/gp/codegen.h"
 #   include "../disassembler/utgard/pp/codegen.h"
 #   include "../disassembler/midgard/disassemble.h"
@@ -16,6 +23,39 @@ extern "C" {
 
 namespace MaliCompiler {
 
+// Second phase of a two-phase disassembly
+//
+// Once the boundaries of the instructions are known, a long program is cut
+// into one slice per core, every slice is decoded into a sink and context of
+// its own and the sinks are merged back in order. Short programs stay on the
+// calling thread where the threads would cost more than they save.
+template <class Decode>
+static void Parallel(Sink& sink, FILE* context, size_t count, Decode decode)
+{
+    static constexpr size_t SLICE_MIN = 1024;
+
+    size_t threads = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), count / SLICE_MIN);
+    if (threads <= 1) {
+        decode(sink, context, 0, count);
+        return;
+    }
+
+    unsigned debug = mesa_debug(context);
+    std::vector<Sink> sinks(threads);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i] {
+            FILE* context = mesa_context_create(&sinks[i], debug);
+            decode(sinks[i], context, count * i / threads, count * (i + 1) / threads);
+            mesa_context_destroy(context);
+        });
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        workers[i].join();
+        sink.Merge(sinks[i]);
+    }
+}
+
 mine* NextProcess(mine* cpu)
 {
     auto* allocator = cpu->Allocator;
@@ -28,6 +68,8 @@ mine* NextProcess(mine* cpu)
 
     switch (stack[2]) {
     case 'MALI': {
+        Trace<TRACE_MALI>("%-12s : %08X", "MALI", EAX);
+        Timeline::Scope scope("MaliCompiler::MALI");
         auto binary_data_size = stack[5];
         auto binary = stack[6] ? (uint32_t*)(memory + stack[6]) : nullptr;
         auto number_of_errors = stack[7];
@@ -41,59 +83,60 @@ mine* NextProcess(mine* cpu)
             std::vector<char>& binary = ShaderCompiler::outputs["Machine"].binary;
             binary.assign(code, code + size);
 
-            std::string& disasm = ShaderCompiler::outputs["Machine"].disasm;
-            uint32_t* chunks = (uint32_t*)binary.data();
-            int type = 0;
-            for (size_t i = 0, size = binary.size() / 4; i < size; ++i) {
-                if (chunks[i] == __builtin_bswap32('CVER')) {
-                    type = 'vert';
-                    continue;
-                }
-                if (chunks[i] == __builtin_bswap32('CFRA')) {
-                    type = 'frag';
+            Sink sink;
+            FILE* context = mesa_context_create(&sink, 0);
+            auto sections = Container::Parse(Container::Span(binary.data(), binary.size()), Container::Format::MBS);
+            for (auto& section : sections) {
+                if (section.name != "DBIN" && section.name != "OBJC")
                     continue;
+                int type = 0;
+                for (int parent = section.parent; parent >= 0 && type == 0; parent = sections[parent].parent) {
+                    if (sections[parent].name == "CVER")
+                        type = 'vert';
+                    if (sections[parent].name == "CFRA")
+                        type = 'frag';
                 }
-                if (chunks[i] == __builtin_bswap32('DBIN')) {
-                    int size = chunks[i + 1];
-                    uint32_t* bin = chunks + i + 2;
+                uint32_t* bin = (uint32_t*)section.data.data;
+                size_t size = section.data.size;
+                if (section.name == "DBIN") {
+                    Timeline::Scope scope("Mesa::Utgard");
                     if (type == 'vert') {
                         gpir_codegen_instr* instr = (gpir_codegen_instr *)bin;
-                        gpir_disassemble_program(instr, size / sizeof(gpir_codegen_instr), (FILE*)&disasm);
+                        Parallel(sink, context, size / sizeof(gpir_codegen_instr), [&](Sink&, FILE* context, size_t begin, size_t end) {
+                            gpir_disassemble_range(instr, unsigned(begin), unsigned(end), context);
+                        });
                     }
                     else if (type == 'frag') {
-                        size >>= 2;
+                        // Every instruction starts with its length in words
+                        std::vector<uint32_t> offsets;
+                        size_t words = size / sizeof(uint32_t);
                         uint32_t offset = 0;
-                        do {
-                            ppir_codegen_ctrl *ctrl = (ppir_codegen_ctrl *)bin;
-                            mesa_fprintf((FILE*)&disasm, "@%6d: ", offset);
-                            ppir_disassemble_instr(bin, offset, (FILE*)&disasm);
-                            bin += ctrl->count;
+                        while (offset < words) {
+                            ppir_codegen_ctrl *ctrl = (ppir_codegen_ctrl *)(bin + offset);
+                            if (ctrl->count == 0 || offset + ctrl->count > words)
+                                break;
+                            offsets.push_back(offset);
                             offset += ctrl->count;
-                            size -= ctrl->count;
-                        } while (size > 0);
+                        }
+                        Parallel(sink, context, offsets.size(), [&](Sink& sink, FILE* context, size_t begin, size_t end) {
+                            for (size_t i = begin; i < end; ++i) {
+                                sink.Print("@%6d: ", offsets[i]);
+                                ppir_disassemble_instr(bin + offsets[i], offsets[i], context);
+                            }
+                        });
                     }
-                    mesa_cleanup();
-                    break;
                 }
-                if (chunks[i] == __builtin_bswap32('OBJC')) {
-                    int size = chunks[i + 1];
-                    uint32_t* bin = chunks + i + 2;
-                    disassemble_midgard((FILE*)&disasm, bin, size, 0, false);
-                    mesa_cleanup();
-                    break;
+                else {
+                    Timeline::Scope scope("Mesa::Midgard");
+                    disassemble_midgard(context, bin, size, 0, false);
                 }
+                break;
             }
 
-            for (size_t i = 0, column = 0; i < disasm.size(); ++i, ++column) {
-                switch (disasm[i]) {
-                case '\n':
-                    column = -1;
-                    break;
-                case '\t':
-                    disasm.replace(i, 1, (8 - column % 8), ' ');
-                    break;
-                }
-            }
+            mesa_context_destroy(context);
+
+            auto& machine = ShaderCompiler::outputs["Machine"];
+            sink.Flush(machine);
         }
         for (size_t i = 0; i < number_of_errors; ++i) {
             auto error = errors[i] ? (char*)(memory + errors[i]) : nullptr;
@@ -110,6 +153,9 @@ mine* NextProcess(mine* cpu)
         if (EAX != 0) {
             Logger<CONSOLE>("Compile : %08X\n", EAX);
         }
+        else if (binary) {
+            ShaderCompiler::completed = true;
+        }
         break;
     }
     default:
@@ -1,6 +1,8 @@
 #include <string>
 #include "Logger.h"
 #include "ShaderCompiler.h"
+#include "Sink.h"
+#include "Timeline.h"
 #include "VirtualMachine.h"
 #include "../mine/syscall/allocator.h"
 #include "../mine/x86/x86_i386.h"
@@ -9,6 +11,50 @@
 
 namespace NVCompiler {
 
+using ShaderCompiler::Instruction;
+
+static const Sink::Syntax syntax = {
+    .comments = { "//", "#" },
+    .files = {
+        { "R", Instruction::Register },
+        { "UR", Instruction::Uniform },
+        { "c", Instruction::Constant },
+        { "P", Instruction::Predicate },
+        { "UP", Instruction::Predicate },
+        { "a", Instruction::Input },
+        { "o", Instruction::Output },
+    },
+    .units = {
+        { "TEX", Instruction::Texture },
+        { "TLD", Instruction::Texture },
+        { "TXQ", Instruction::Texture },
+        { "TXD", Instruction::Texture },
+        { "TMML", Instruction::Texture },
+        { "BRA", Instruction::Flow },
+        { "BRK", Instruction::Flow },
+        { "BSSY", Instruction::Flow },
+        { "BSYNC", Instruction::Flow },
+        { "CAL", Instruction::Flow },
+        { "EXIT", Instruction::Flow },
+        { "JMP", Instruction::Flow },
+        { "KIL", Instruction::Flow },
+        { "RET", Instruction::Flow },
+        { "SSY", Instruction::Flow },
+        { "SYNC", Instruction::Flow },
+        { "BAR", Instruction::Sync },
+        { "DEPBAR", Instruction::Sync },
+        { "MEMBAR", Instruction::Sync },
+        { "IPA", Instruction::Varying },
+        { "ALD", Instruction::Varying },
+        { "AST", Instruction::Varying },
+        { "LD", Instruction::Memory },
+        { "ST", Instruction::Memory },
+        { "ATOM", Instruction::Memory },
+        { "RED", Instruction::Memory },
+        { "MUFU", Instruction::Special },
+    },
+};
+
 mine* NextProcess(mine* cpu)
 {
     auto* allocator = cpu->Allocator;
@@ -21,6 +67,8 @@ mine* NextProcess(mine* cpu)
 
     switch (stack[0]) {
     case 'NVDA': {
+        Trace<TRACE_NV>("%-12s : %08X", "NVDA", EAX);
+        Timeline::Scope scope("NVCompiler::NVDA");
         auto* binary_blob = stack[1] ? (uint32_t*)(memory + stack[1]) : nullptr;
         auto* disasm_blob = stack[2] ? (uint32_t*)(memory + stack[2]) : nullptr;
         if ((binary_blob || disasm_blob) && EAX == 0) {
@@ -37,21 +85,12 @@ mine* NextProcess(mine* cpu)
                 auto& pointer = disasm_blob[3];
                 auto* code = (char*)(memory + pointer);
 
-                std::string& disasm = ShaderCompiler::outputs["Machine"].disasm;
-                disasm.assign(code, code + size);
-                disasm.resize(strlen(disasm.c_str()));
-
-                for (size_t i = 0, column = 0; i < disasm.size(); ++i, ++column) {
-                    switch (disasm[i]) {
-                    case '\n':
-                        column = -1;
-                        break;
-                    case '\t':
-                        disasm.replace(i, 1, (8 - column % 8), ' ');
-                        break;
-                    }
-                }
+                auto& machine = ShaderCompiler::outputs["Machine"];
+                Sink sink;
+                sink.Write(code, size);
+                sink.Flush(machine, &syntax);
             }
+            ShaderCompiler::completed = true;
         }
         else {
             Logger<CONSOLE>("Compile : %08X\n", EAX);
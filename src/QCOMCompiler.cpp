@@ -1,5 +1,10 @@
+#include <algorithm>
+#include <string_view>
+#include "Container.h"
 #include "Logger.h"
 #include "ShaderCompiler.h"
+#include "Sink.h"
+#include "Timeline.h"
 #include "VirtualMachine.h"
 #include "../mine/syscall/allocator.h"
 #include "../mine/x86/x86_i386.h"
@@ -7,12 +12,43 @@
 #include "../mine/x86/x86_register.inl"
 
 extern "C" {
-    void mesa_cleanup();
+    FILE* mesa_context_create(void* sink, unsigned debug);
+    void mesa_context_destroy(FILE* fp);
 #   include "../disassembler/adreno/disasm.h"
 };
 
 namespace QCOMCompiler {
 
+static void Stats(ShaderCompiler::AdrenoStats& adreno, const shader_stats& stats, int gpu_id, bool valid)
+{
+    // a6xx and later merge the half registers into the full register file
+    int fullreg = stats.fullreg;
+    int halfreg = stats.halfreg;
+    if (gpu_id >= 600) {
+        fullreg = std::max(fullreg, (halfreg + 1) / 2);
+        halfreg = 0;
+    }
+
+    adreno.valid = valid;
+    adreno.instructions = stats.instructions;
+    adreno.instlen = stats.instlen;
+    adreno.nops = stats.nops;
+    adreno.mov = stats.mov_count;
+    adreno.cov = stats.cov_count;
+    adreno.ss = stats.ss;
+    adreno.sy = stats.sy;
+    adreno.sstall = stats.sstall;
+    adreno.fullreg = (fullreg + 3) / 4;
+    adreno.halfreg = (halfreg + 3) / 4;
+    adreno.constlen = (stats.constlen + 3) / 4;
+    adreno.last_baryf = stats.last_baryf;
+    std::copy(std::begin(stats.instrs_per_cat), std::end(stats.instrs_per_cat), adreno.instrs_per_cat);
+
+    Logger<CONSOLE>("Adreno : %d instr, %d nops, %d full, %d half, %d constlen, %d sstall, %d (ss), %d (sy)\n",
+                    adreno.instructions, adreno.nops, adreno.fullreg, adreno.halfreg, adreno.constlen,
+                    adreno.sstall, adreno.ss, adreno.sy);
+}
+
 mine* NextProcess(mine* cpu)
 {
     auto* allocator = cpu->Allocator;
@@ -25,6 +61,8 @@ mine* NextProcess(mine* cpu)
 
     switch (stack[0]) {
     case 'QCOM': {
+        Trace<TRACE_QCOM>("%-12s : %08X", "QCOM", EAX);
+        Timeline::Scope scope("QCOMCompiler::QCOM");
         auto binary = stack[1] ? (uint32_t*)(memory + stack[1]) : nullptr;
         auto binary_data_size = stack[2];
         if (binary) {
@@ -34,51 +72,40 @@ mine* NextProcess(mine* cpu)
             std::vector<char>& binary = ShaderCompiler::outputs["Machine"].binary;
             binary.assign(code, code + size);
 
-            std::string& disasm = ShaderCompiler::outputs["Machine"].disasm;
-            if (binary.size() > 6) {
-                uint32_t* datas = (uint32_t*)binary.data();
-                uint32_t section_binary = datas[1];
-                uint32_t section_gpu = datas[4];
-                uint32_t section_offset = datas[5];
-                uint32_t section_count = datas[6];
+            auto& machine = ShaderCompiler::outputs["Machine"];
+            Container::Span datas(binary.data(), binary.size());
+            uint32_t section_binary = datas.Word(4);
+            uint32_t section_gpu = datas.Word(16);
 
-                int gpu_id = 300;
-                switch (section_gpu) {
-                case 0: gpu_id = 300;   break;
-                case 1: gpu_id = 400;   break;
-                case 2: gpu_id = 500;   break;
-                case 3: gpu_id = 600;   break;
-                case 4: gpu_id = 700;   break;
-                }
-
-                for (size_t i = 0; i < section_count; ++i) {
-                    uint32_t* section = &datas[section_offset / sizeof(uint32_t) + i * 5];
-                    uint32_t number = section[0];
-                    uint32_t offset = section[1];
-                    uint32_t size = section[2];
-                    if (number == section_binary) {
-                        disasm_a3xx_set_debug(PRINT_RAW);
-                        try_disasm_a3xx(&datas[offset / sizeof(uint32_t)], size / sizeof(uint32_t), 0, (FILE*)&disasm, gpu_id);
-                        mesa_cleanup();
-                        break;
-                    }
-                }
+            int gpu_id = 300;
+            switch (section_gpu) {
+            case 0: gpu_id = 300;   break;
+            case 1: gpu_id = 400;   break;
+            case 2: gpu_id = 500;   break;
+            case 3: gpu_id = 600;   break;
+            case 4: gpu_id = 700;   break;
+            }
 
-                for (size_t i = 0, column = 0; i < disasm.size(); ++i, ++column) {
-                    switch (disasm[i]) {
-                    case '\n':
-                        column = -1;
-                        break;
-                    case '\t':
-                        disasm.replace(i, 1, (8 - column % 8), ' ');
-                        break;
-                    }
+            for (auto& section : Container::Parse(datas, Container::Format::QCOM)) {
+                if (section.id == section_binary) {
+                    Timeline::Scope scope("Mesa::Adreno");
+                    Sink sink;
+                    FILE* context = mesa_context_create(&sink, PRINT_RAW);
+                    shader_stats stats;
+                    int result = try_disasm_a3xx_stat((uint32_t*)section.data.data, int(section.data.size / sizeof(uint32_t)), 0, context, gpu_id, &stats);
+                    mesa_context_destroy(context);
+                    sink.Flush(machine);
+                    Stats(machine.adreno, stats, gpu_id, result == 0);
+                    break;
                 }
             }
         }
         if (EAX != 0) {
             Logger<CONSOLE>("Compile : %08X\n", EAX);
         }
+        else if (binary) {
+            ShaderCompiler::completed = true;
+        }
         break;
     }
     default:
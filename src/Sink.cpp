@@ -0,0 +1,329 @@
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ShaderCompiler.h"
+#include "Sink.h"
+
+using ShaderCompiler::Instruction;
+
+void Sink::Append(const char* text, size_t length)
+{
+    while (length) {
+        if (chunks.empty() || chunks.back().size() == CHUNK_SIZE) {
+            chunks.emplace_back();
+            chunks.back().reserve(CHUNK_SIZE);
+        }
+        auto& chunk = chunks.back();
+        size_t count = std::min(length, CHUNK_SIZE - chunk.size());
+        chunk.append(text, count);
+        size += count;
+        text += count;
+        length -= count;
+    }
+}
+
+void Sink::Fill(char c, size_t count)
+{
+    static const char spaces[8] = { ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ' };
+    if (c == ' ' && count <= sizeof(spaces)) {
+        Append(spaces, count);
+        return;
+    }
+    while (count--) {
+        Append(&c, 1);
+    }
+}
+
+void Sink::Write(const char* text, size_t length)
+{
+    const char* end = text + length;
+    while (text < end) {
+        const char* span = text;
+        while (span < end && (*span) != '\t' && (*span) != '\n' && (*span) != '\0')
+            span++;
+        Append(text, span - text);
+        column += span - text;
+        if (span == end)
+            break;
+        switch (*span) {
+        case '\t': {
+            size_t tab = 8 - column % 8;
+            Fill(' ', tab);
+            column += tab;
+            break;
+        }
+        case '\n':
+            Append(span, 1);
+            lines.push_back((uint32_t)size);
+            column = 0;
+            break;
+        case '\0':
+            // Blobs copied out of the emulator stop at the first terminator
+            return;
+        }
+        text = span + 1;
+    }
+}
+
+void Sink::Write(const char* text)
+{
+    Write(text, strlen(text));
+}
+
+int Sink::Print(const char* format, ...)
+{
+    va_list va;
+    va_start(va, format);
+    int length = PrintV(format, va);
+    va_end(va);
+    return length;
+}
+
+int Sink::PrintV(const char* format, va_list va)
+{
+    char temp[256];
+    va_list copy;
+    va_copy(copy, va);
+    int length = vsnprintf(temp, sizeof(temp), format, copy);
+    va_end(copy);
+    if (length < 0)
+        return length;
+    if (size_t(length) < sizeof(temp)) {
+        Write(temp, length);
+        return length;
+    }
+
+    // Long lines are formatted again at their exact size instead of being cut
+    std::string text(length + 1, '\0');
+    vsnprintf(text.data(), text.size(), format, va);
+    Write(text.data(), length);
+    return length;
+}
+
+uint16_t Sink::Opcode(const char* opcode, size_t length)
+{
+    auto [it, inserted] = opcode_ids.try_emplace(std::string(opcode, length), uint16_t(opcodes.size()));
+    if (inserted) {
+        opcodes.emplace_back(opcode, length);
+    }
+    return (*it).second;
+}
+
+void Sink::Record(uint32_t offset, uint32_t size, const char* opcode, uint8_t unit, const uint32_t* operands, size_t count)
+{
+    if (opcode == nullptr)
+        opcode = "unknown";
+
+    Instruction instruction = {};
+    instruction.offset = offset;
+    instruction.size = uint16_t(size);
+    instruction.opcode = Opcode(opcode, strlen(opcode));
+    instruction.unit = unit;
+    instruction.count = uint8_t(std::min(count, std::size(instruction.operands)));
+    std::copy_n(operands, instruction.count, instruction.operands);
+    instruction.line = uint32_t(lines.size() - 1);
+    instructions.push_back(instruction);
+}
+
+void Sink::Parse(const std::string& text, const Syntax& syntax)
+{
+    auto starts = [](const char* begin, const char* end, const char* prefix, bool ignore_case) {
+        for (; *prefix; ++begin, ++prefix) {
+            if (begin == end)
+                return false;
+            char a = *begin;
+            char b = *prefix;
+            if (ignore_case) {
+                a = tolower((unsigned char)a);
+                b = tolower((unsigned char)b);
+            }
+            if (a != b)
+                return false;
+        }
+        return true;
+    };
+
+    size_t first = instructions.size();
+    uint32_t index = 0;
+    bool offsets = false;
+    for (size_t line = 0; line < lines.size(); ++line) {
+        const char* begin = text.data() + lines[line];
+        const char* end = (line + 1 < lines.size()) ? text.data() + lines[line + 1] : text.data() + text.size();
+        while (begin < end && isspace((unsigned char)*begin))
+            begin++;
+
+        // Offset prefix : /*0008*/
+        bool offset_found = false;
+        uint32_t offset = 0;
+        if (starts(begin, end, "/*", false)) {
+            char* next = nullptr;
+            offset = (uint32_t)strtoul(begin + 2, &next, 16);
+            const char* close = std::search(begin, end, "*/", "*/" + 2);
+            offset_found = (next != begin + 2 && close != end);
+            begin = (close != end) ? close + 2 : end;
+            while (begin < end && isspace((unsigned char)*begin))
+                begin++;
+        }
+
+        // Comment
+        const char* comment = end;
+        for (const char* prefix : syntax.comments) {
+            const char* found = std::search(begin, end, prefix, prefix + strlen(prefix));
+            comment = std::min(comment, found);
+        }
+        if (comment == begin)
+            continue;
+
+        // Offset and encoding in the comment : // 000000000010: BF8C0070 BE80000C
+        uint32_t size = 0;
+        for (const char* c = comment; c < end && offset_found == false; ++c) {
+            if (isxdigit((unsigned char)*c) == false)
+                continue;
+            char* next = nullptr;
+            uint32_t value = (uint32_t)strtoul(c, &next, 16);
+            if (next - c >= 4 && next < end && *next == ':') {
+                offset = value;
+                offset_found = true;
+                for (c = next + 1; c < end; c = next) {
+                    while (c < end && *c == ' ')
+                        c++;
+                    const char* word = c;
+                    while (c < end && isxdigit((unsigned char)*c))
+                        c++;
+                    if (c - word != 8)
+                        break;
+                    size += 4;
+                    next = (char*)c;
+                }
+            }
+            break;
+        }
+
+        // Predicate or co-issue prefix
+        while (begin < comment && (*begin == '@' || *begin == '+')) {
+            if (*begin == '@') {
+                while (begin < comment && isspace((unsigned char)*begin) == false)
+                    begin++;
+            }
+            else {
+                begin++;
+            }
+            while (begin < comment && isspace((unsigned char)*begin))
+                begin++;
+        }
+
+        // Mnemonic
+        const char* mnemonic = begin;
+        while (begin < comment && isspace((unsigned char)*begin) == false && *begin != ',' && *begin != ';' && *begin != '(')
+            begin++;
+        if (mnemonic == begin || isalpha((unsigned char)*mnemonic) == false || *mnemonic == '.' || begin[-1] == ':')
+            continue;
+
+        Instruction instruction = {};
+        instruction.offset = offset_found ? offset : index;
+        offsets |= offset_found;
+        instruction.size = uint16_t(size);
+        instruction.opcode = Opcode(mnemonic, begin - mnemonic);
+        instruction.unit = Instruction::ALU;
+        for (auto& unit : syntax.units) {
+            if (starts(mnemonic, begin, unit.prefix, true)) {
+                instruction.unit = unit.unit;
+                break;
+            }
+        }
+        instruction.line = uint32_t(line);
+
+        // Operands : r0, v[4:7], c[0x0][0x28]
+        for (const char* c = begin; c < comment && instruction.count < std::size(instruction.operands); ) {
+            if (isalpha((unsigned char)*c) == false || (c > begin && (isalnum((unsigned char)c[-1]) || c[-1] == '_' || c[-1] == '.'))) {
+                c++;
+                continue;
+            }
+            const char* name = c;
+            while (c < comment && isalpha((unsigned char)*c))
+                c++;
+            const char* number = (c < comment && *c == '[') ? c + 1 : c;
+            if (number == comment || isdigit((unsigned char)*number) == false)
+                continue;
+            for (auto& file : syntax.files) {
+                if (strlen(file.prefix) == size_t(c - name) && starts(name, c, file.prefix, false)) {
+                    uint32_t value = (uint32_t)strtoul(number, nullptr, 0);
+                    instruction.operands[instruction.count++] = Instruction::Operand(file.file, value);
+                    break;
+                }
+            }
+            while (c < comment && isalnum((unsigned char)*c))
+                c++;
+        }
+
+        instructions.push_back(instruction);
+        index++;
+    }
+
+    // Sizes follow from the next offset when the text only carries offsets
+    for (size_t i = first; offsets && i + 1 < instructions.size(); ++i) {
+        auto& instruction = instructions[i];
+        auto& next = instructions[i + 1];
+        if (instruction.size == 0 && next.offset > instruction.offset) {
+            instruction.size = uint16_t(next.offset - instruction.offset);
+        }
+    }
+}
+
+void Sink::Merge(Sink& other)
+{
+    // The other sink is expected to start on a fresh line, tabs were expanded
+    // from its own column 0
+    uint32_t base = uint32_t(size);
+    uint32_t line = uint32_t(lines.size() - 1);
+    for (auto& chunk : other.chunks) {
+        Append(chunk.data(), chunk.size());
+    }
+    for (size_t i = 1; i < other.lines.size(); ++i) {
+        lines.push_back(base + other.lines[i]);
+    }
+    column = (other.lines.size() > 1) ? other.column : column + other.column;
+    for (auto instruction : other.instructions) {
+        auto& opcode = other.opcodes[instruction.opcode];
+        instruction.opcode = Opcode(opcode.data(), opcode.size());
+        instruction.line += line;
+        instructions.push_back(instruction);
+    }
+    other.Clear();
+}
+
+void Sink::Flush(ShaderCompiler::Output& output, const Syntax* syntax)
+{
+    output.disasm.clear();
+    output.disasm.reserve(size);
+    for (auto& chunk : chunks) {
+        output.disasm += chunk;
+    }
+    if (lines.size() > 1 && lines.back() == size) {
+        lines.pop_back();
+    }
+    if (syntax) {
+        Parse(output.disasm, *syntax);
+    }
+    output.lines = std::move(lines);
+    output.instructions = std::move(instructions);
+    output.opcodes = std::move(opcodes);
+    Clear();
+}
+
+void Sink::Clear()
+{
+    chunks.clear();
+    lines.assign(1, 0);
+    instructions.clear();
+    opcodes.clear();
+    opcode_ids.clear();
+    size = 0;
+    column = 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Text sink shared by every disassembler backend
+//
+// Output is appended to fixed size chunks so a long listing never moves what
+// has already been written, tabs are expanded to 8 columns as the text comes
+// in and the start offset of every line is recorded for the viewer.
+//
+// Backends that decode the binary themselves report instruction records
+// directly, text coming from a vendor DLL is turned into records by Parse.
+// Sinks filled by separate threads are joined in program order with Merge.
+struct Sink {
+    static constexpr size_t CHUNK_SIZE = 65536;
+
+    struct Syntax {
+        struct File {
+            const char* prefix;
+            ShaderCompiler::Instruction::File file;
+        };
+        struct Unit {
+            const char* prefix;
+            ShaderCompiler::Instruction::Unit unit;
+        };
+        std::vector<const char*> comments;
+        std::vector<File> files;
+        std::vector<Unit> units;
+    };
+
+    void Write(const char* text, size_t length);
+    void Write(const char* text);
+    int Print(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    int PrintV(const char* format, va_list va);
+    void Record(uint32_t offset, uint32_t size, const char* opcode, uint8_t unit, const uint32_t* operands, size_t count);
+    void Merge(Sink& other);
+    void Flush(ShaderCompiler::Output& output, const Syntax* syntax = nullptr);
+    void Clear();
+
+private:
+    void Append(const char* text, size_t length);
+    void Fill(char c, size_t count);
+    uint16_t Opcode(const char* opcode, size_t length);
+    void Parse(const std::string& text, const Syntax& syntax);
+
+    std::vector<std::string> chunks;
+    std::vector<uint32_t> lines = { 0 };
+    std::vector<ShaderCompiler::Instruction> instructions;
+    std::vector<std::string> opcodes;
+    std::unordered_map<std::string, uint16_t> opcode_ids;
+    size_t size = 0;
+    size_t column = 0;
+};
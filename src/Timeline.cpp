@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Logger.h"
+#include "Timeline.h"
+
+namespace Timeline {
+
+// Stage timings, written out as Chrome trace events
+//
+// Every event carries the job id of the thread which recorded it and a track
+// number per thread, so a sweep shows one row per worker in Perfetto or
+// chrome://tracing and a single job can be cut out of it. Names are literals
+// and are kept by pointer.
+struct Event {
+    const char* name;
+    int64_t begin;
+    int64_t end;
+    uint32_t job;
+    uint32_t track;
+};
+
+static const size_t max_events = 1 << 20;
+static std::mutex event_mutex;
+static std::vector<Event> events;
+static bool full;
+static std::atomic<uint32_t> track_serial;
+static const auto origin = std::chrono::steady_clock::now();
+
+Scope::Scope(const char* name) : name(name), begin(Now())
+{
+}
+
+Scope::~Scope()
+{
+    Record(name, begin, Now());
+}
+
+int64_t Now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void Record(const char* name, int64_t begin, int64_t end)
+{
+    thread_local uint32_t track = track_serial++;
+    {
+        std::lock_guard<std::mutex> lock(event_mutex);
+        if (events.size() < max_events) {
+            events.push_back({ name, begin, end, logs_job, track });
+            return;
+        }
+        if (full)
+            return;
+        full = true;
+    }
+    Logger<SYSTEM>("Timeline : %s (%zu)\n", "Event limit is reached, later stages are not recorded", max_events);
+}
+
+bool Export(const std::string& path, uint32_t job)
+{
+    std::vector<Event> copy;
+    {
+        std::lock_guard<std::mutex> lock(event_mutex);
+        copy = events;
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+
+    // A single job is one process, a whole sweep is one process with a track per worker
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    const char* separator = "";
+    std::vector<uint32_t> named;
+    for (auto& event : copy) {
+        if (job && event.job != job)
+            continue;
+        uint32_t pid = job ? job : 0;
+        if (named.empty()) {
+            std::string name = job ? "Job " + std::to_string(job) : "Sweep";
+            fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"%s\"}}", pid, name.c_str());
+            separator = ",\n";
+        }
+        if (std::find(named.begin(), named.end(), event.track) == named.end()) {
+            named.push_back(event.track);
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}}", separator, pid, event.track, event.track);
+        }
+        fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"stage\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%u,\"tid\":%u,\"args\":{\"job\":%u}}", separator, event.name, (long long)event.begin, (long long)(event.end - event.begin), pid, event.track, event.job);
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
+
+void Clear()
+{
+    std::lock_guard<std::mutex> lock(event_mutex);
+    events.clear();
+    full = false;
+}
+
+};  // namespace Timeline
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace Timeline {
+
+struct Scope {
+    Scope(const char* name);
+    ~Scope();
+
+    const char* name;
+    int64_t begin;
+};
+
+int64_t Now();
+void Record(const char* name, int64_t begin, int64_t end);
+bool Export(const std::string& path, uint32_t job = 0);
+void Clear();
+
+};  // namespace Timeline
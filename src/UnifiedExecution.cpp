@@ -1,4 +1,6 @@
 #include <string>
+#include <string_view>
+#include "Container.h"
 #include "Logger.h"
 #include "ShaderCompiler.h"
 #include "VirtualMachine.h"
@@ -9,6 +11,111 @@
 
 namespace UnifiedExecution {
 
+using ShaderCompiler::Parameter;
+
+bool Compile(const std::vector<std::string>& tokens, ShaderCompiler::Machine& machine)
+{
+    machine = ShaderCompiler::Machine();
+    if (tokens.size() < 2 || tokens[1].empty()) {
+        Logger<CONSOLE>("Machine : %s (%s)\n", "Entry is not found", tokens.empty() ? "" : tokens[0].c_str());
+        return false;
+    }
+    machine.name = tokens[0];
+    machine.entry = tokens[1];
+
+    for (size_t i = 2; i < tokens.size(); ++i) {
+        const std::string& token = tokens[i];
+        const char* parameter = token.c_str();
+        const char* error = nullptr;
+        switch (parameter[0]) {
+        case 0:
+            break;
+        case '0' ... '9': {
+            char* end = nullptr;
+            unsigned long value = (parameter[1] == 'x') ? strtoul(parameter, &end, 16) : strtoul(parameter, &end, 10);
+            if (end == nullptr || (*end) != 0 || value > UINT32_MAX) {
+                error = "Number is malformed";
+                break;
+            }
+            machine.parameters.push_back({ Parameter::PushImmediate, uint32_t(value) });
+            break;
+        }
+        case '(': {
+            char* end = nullptr;
+            long count = strtol(parameter + 1, &end, 10);
+            if (end == nullptr || end[0] != ')' || end[1] != 0 || count < 1) {
+                error = "Stack reference is malformed";
+                break;
+            }
+            machine.parameters.push_back({ Parameter::PushStack, uint32_t(count - 1) });
+            break;
+        }
+        case '\'': {
+            if (token.size() != 6 || token.back() != '\'') {
+                error = "Four character code is malformed";
+                break;
+            }
+            uint32_t type = 0;
+            for (size_t i = 1; i < 5; ++i) {
+                type <<= 8;
+                type |= uint8_t(parameter[i]);
+            }
+            machine.parameters.push_back({ Parameter::PushImmediate, type });
+            break;
+        }
+        case '\"': {
+            if (token.size() < 2 || token.back() != '\"') {
+                error = "String is malformed";
+                break;
+            }
+            machine.parameters.push_back({ Parameter::PushString, uint32_t(machine.strings.size()) });
+            machine.strings.append(token, 1, token.size() - 2);
+            machine.strings.push_back(0);
+            break;
+        }
+        default:
+            static const struct {
+                const char* name;
+                Parameter::Buffer buffer;
+            } buffers[] = {
+                { "pSrcData",       Parameter::SrcData      },
+                { "SrcDataSize",    Parameter::SrcDataSize  },
+                { "pSHDRData",      Parameter::SHDRData     },
+                { "SHDRDataSize",   Parameter::SHDRDataSize },
+                { "ShaderType",     Parameter::ShaderType   },
+                { "shader_type",    Parameter::ShaderType   },
+                { "pOutput",        Parameter::Output       },
+                { "OutputSize",     Parameter::OutputSize   },
+            };
+            error = "Parameter is unknown";
+            for (auto& [name, buffer] : buffers) {
+                if (token == name) {
+                    machine.parameters.push_back({ Parameter::PushBuffer, buffer });
+                    error = nullptr;
+                    break;
+                }
+            }
+            break;
+        }
+        if (error) {
+            Logger<CONSOLE>("Machine : %s (%s : %s)\n", error, machine.name.c_str(), parameter);
+            return false;
+        }
+    }
+
+    // Canonical key, equal for every machine line producing the same call
+    machine.key = machine.entry;
+    machine.key.push_back(0);
+    for (auto& parameter : machine.parameters) {
+        machine.key.push_back(char(parameter.opcode));
+        machine.key.append((char*)&parameter.value, sizeof(parameter.value));
+    }
+    machine.key.push_back(0);
+    machine.key += machine.strings;
+
+    return true;
+}
+
 size_t RunDriver(mine* cpu, size_t(*symbol)(mine*, void*, const char*))
 {
     auto* allocator = cpu->Allocator;
@@ -19,116 +126,81 @@ size_t RunDriver(mine* cpu, size_t(*symbol)(mine*, void*, const char*))
         ShaderCompiler::drivers[ShaderCompiler::driver_index].machines.size() > ShaderCompiler::machine_index) {
         auto& driver = ShaderCompiler::drivers[ShaderCompiler::driver_index];
         auto& machine = driver.machines[ShaderCompiler::machine_index];
-        if (machine.size() < 2)
-            return 0;
-        size_t SrcDataSize = 0;
-        size_t pSrcData = 0;
-        size_t SHDRDataSize = 0;
-        size_t pSHDRData = 0;
-        size_t ShaderType = 0;
-        size_t OutputSize = 0;
-        size_t pOutput = 0;
 
-        size_t entry = symbol(cpu, nullptr, machine[1].c_str());
+        size_t entry = symbol(cpu, nullptr, machine.entry.c_str());
         if (entry) {
-            for (size_t i = 2; i < machine.size(); ++i) {
-                const char* parameter = machine[i].c_str();
-                switch (parameter[0]) {
-                case 0:
+            uint32_t pStrings = 0;
+            if (machine.strings.empty() == false)
+                pStrings = VirtualMachine::DataToMemory(machine.strings.data(), machine.strings.size(), allocator);
+
+            uint32_t buffers[Parameter::BufferCount] = {};
+            auto buffer = [&](uint32_t index) {
+                if (index >= Parameter::BufferCount)
+                    return uint32_t(0);
+                switch (index) {
+                case Parameter::SrcData:
+                case Parameter::SrcDataSize:
+                    if (buffers[Parameter::SrcData] == 0 && buffers[Parameter::SrcDataSize] == 0) {
+                        auto& output = ShaderCompiler::outputs[""];
+                        buffers[Parameter::SrcData] = VirtualMachine::DataToMemory(output.binary.data(), output.binary.size(), allocator);
+                        buffers[Parameter::SrcDataSize] = uint32_t(output.binary.size());
+                    }
                     break;
-                case '0' ... '9':
-                    if (parameter[1] == 'x') {
-                        Push32(strtol(parameter, nullptr, 16));
-                        break;
+                case Parameter::SHDRData:
+                case Parameter::SHDRDataSize:
+                    if (buffers[Parameter::SHDRData] == 0 && buffers[Parameter::SHDRDataSize] == 0) {
+                        auto& output = ShaderCompiler::outputs[""];
+                        Container::Span binary(output.binary.data(), output.binary.size());
+                        Container::Span shader = Container::Find(binary, Container::Format::DXBC, "SHEX");
+                        if (!shader)
+                            shader = Container::Find(binary, Container::Format::DXBC, "SHDR");
+                        if (shader) {
+                            buffers[Parameter::SHDRData] = VirtualMachine::DataToMemory(shader.data, shader.size, allocator);
+                            buffers[Parameter::SHDRDataSize] = uint32_t(shader.size);
+                        }
                     }
-                    Push32(strtol(parameter, nullptr, 10));
                     break;
-                case '(': {
-                    auto count = strtol(parameter + 1, nullptr, 10) - 1;
-                    auto stack = ESP + sizeof(uint32_t) * count;
-                    Push32(stack);
+                case Parameter::ShaderType:
+                    if (buffers[Parameter::ShaderType] == 0) {
+                        std::string type = "vertex";
+                        switch (ShaderCompiler::GetShaderType()) {
+                        case 'vert':
+                            type = "vertex";
+                            break;
+                        case 'frag':
+                            type = "fragment";
+                            break;
+                        }
+                        buffers[Parameter::ShaderType] = VirtualMachine::DataToMemory(type.data(), type.size() + 1, allocator);
+                    }
                     break;
-                }
-                case '\'': {
-                    uint32_t type = 0;
-                    for (size_t i = 1; i < 5; ++i) {
-                        type <<= 8;
-                        type |= uint8_t(parameter[i]);
+                case Parameter::Output:
+                case Parameter::OutputSize:
+                    if (buffers[Parameter::Output] == 0 && buffers[Parameter::OutputSize] == 0) {
+                        buffers[Parameter::Output] = VirtualMachine::DataToMemory(nullptr, 1048576, allocator);
+                        buffers[Parameter::OutputSize] = 1048576;
                     }
-                    Push32(type);
                     break;
                 }
-                case '\"': {
-                    auto string = machine[i];
-                    if (string.empty() == false)
-                        string.erase(string.begin());
-                    if (string.empty() == false)
-                        string.pop_back();
-                    auto pString = VirtualMachine::DataToMemory(string.data(), string.size() + 1, allocator);
-                    Push32(pString);
+                return buffers[index];
+            };
+
+            for (auto& parameter : machine.parameters) {
+                switch (parameter.opcode) {
+                case Parameter::PushImmediate:
+                    Push32(parameter.value);
                     break;
-                }
-                default:
-                    if (machine[i] == "pSrcData" || machine[i] == "SrcDataSize") {
-                        if (pSrcData == 0 && SrcDataSize == 0) {
-                            auto& output = ShaderCompiler::outputs[""];
-                            pSrcData = VirtualMachine::DataToMemory(output.binary.data(), output.binary.size(), allocator);
-                            SrcDataSize = output.binary.size();
-                        }
-                        if (machine[i] == "pSrcData")
-                            Push32(pSrcData);
-                        if (machine[i] == "SrcDataSize")
-                            Push32(SrcDataSize);
-                    }
-                    else if (machine[i] == "pSHDRData" || machine[i] == "SHDRDataSize") {
-                        if (pSHDRData == 0 && SHDRDataSize == 0) {
-                            auto& output = ShaderCompiler::outputs[""];
-                            if (output.binary.empty() == false) {
-                                uint32_t* chunks = (uint32_t*)output.binary.data();
-                                size_t size = output.binary.size() / sizeof(uint32_t);
-                                for (size_t i = 0; i < size; ++i) {
-                                    if (chunks[i] == 'XEHS' || chunks[i] == 'RDHS') {
-                                        pSHDRData = VirtualMachine::DataToMemory(chunks + i + 2, chunks[i + 1], allocator);
-                                        SHDRDataSize = chunks[i + 1];
-                                        break;
-                                    }
-                                }
-                            }
-                        }
-                        if (machine[i] == "pSHDRData")
-                            Push32(pSHDRData);
-                        if (machine[i] == "SHDRDataSize")
-                            Push32(SHDRDataSize);
-                    }
-                    else if (machine[i] == "ShaderType" || machine[i] == "shader_type") {
-                        if (ShaderType == 0) {
-                            std::string type = "vertex";
-                            switch (ShaderCompiler::GetShaderType()) {
-                            case 'vert':
-                                type = "vertex";
-                                break;
-                            case 'frag':
-                                type = "fragment";
-                                break;
-                            }
-                            ShaderType = VirtualMachine::DataToMemory(type.data(), type.size() + 1, allocator);
-                        }
-                        Push32(ShaderType);
-                    }
-                    else if (machine[i] == "pOutput" || machine[i] == "OutputSize") {
-                        if (pOutput == 0 && OutputSize == 0) {
-                            pOutput = VirtualMachine::DataToMemory(nullptr, 1048576, allocator);
-                            OutputSize = 1048576;
-                        }
-                        if (machine[i] == "pOutput")
-                            Push32(pOutput);
-                        if (machine[i] == "OutputSize")
-                            Push32(OutputSize);
-                    }
-                    else {
-                        printf("%s\n", machine[i].c_str());
-                    }
+                case Parameter::PushString:
+                    Push32(pStrings + parameter.value);
+                    break;
+                case Parameter::PushBuffer:
+                    Push32(buffer(parameter.value));
                     break;
+                case Parameter::PushStack: {
+                    auto stack = ESP + sizeof(uint32_t) * parameter.value;
+                    Push32(stack);
+                    break;
+                }
                 }
             }
 
@@ -2,8 +2,13 @@
 
 struct mine;
 
+namespace ShaderCompiler {
+struct Machine;
+};  // namespace ShaderCompiler
+
 namespace UnifiedExecution {
 
+bool Compile(const std::vector<std::string>& tokens, ShaderCompiler::Machine& machine);
 size_t RunDriver(mine* cpu, size_t(*symbol)(mine*, void*, const char*));
 
 };  // namespace UnifiedExecution
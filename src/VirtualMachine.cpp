@@ -1,4 +1,5 @@
 #include "Logger.h"
+#include "Timeline.h"
 #include "VirtualMachine.h"
 #include "../mine/format/coff/pe.h"
 #include "../mine/syscall/allocator.h"
@@ -13,6 +14,164 @@
 
 namespace VirtualMachine {
 
+// SHA-256, two images share their results only when the digests of what
+// they map are equal
+struct SHA256 {
+    uint32_t state[8] = {
+        0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+    };
+    uint8_t block[64];
+    size_t used = 0;
+    uint64_t length = 0;
+
+    static uint32_t Rotate(uint32_t value, int count)
+    {
+        return (value >> count) | (value << (32 - count));
+    }
+
+    void Transform()
+    {
+        static const uint32_t k[64] = {
+            0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+            0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+            0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+            0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+            0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+            0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+            0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+            0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+        };
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16) | (uint32_t(block[i * 4 + 2]) << 8) | block[i * 4 + 3];
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = Rotate(w[i - 15], 7) ^ Rotate(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = Rotate(w[i - 2], 17) ^ Rotate(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + (Rotate(e, 6) ^ Rotate(e, 11) ^ Rotate(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            uint32_t t2 = (Rotate(a, 2) ^ Rotate(a, 13) ^ Rotate(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+    void Update(const void* data, size_t size)
+    {
+        auto* bytes = (const uint8_t*)data;
+        length += size;
+        while (size) {
+            size_t count = std::min(size, sizeof(block) - used);
+            memcpy(block + used, bytes, count);
+            used += count;
+            bytes += count;
+            size -= count;
+            if (used == sizeof(block)) {
+                Transform();
+                used = 0;
+            }
+        }
+    }
+
+    std::string Final()
+    {
+        uint64_t bits = length * 8;
+        uint8_t pad = 0x80;
+        Update(&pad, 1);
+        pad = 0;
+        while (used != 56) {
+            Update(&pad, 1);
+        }
+        for (int i = 7; i >= 0; --i) {
+            uint8_t byte = uint8_t(bits >> (i * 8));
+            Update(&byte, 1);
+        }
+        char text[65];
+        for (int i = 0; i < 8; ++i) {
+            snprintf(text + i * 8, 9, "%08X", state[i]);
+        }
+        return text;
+    }
+};
+
+std::string HashImage(const std::string& dll)
+{
+    std::vector<uint8_t> image;
+    FILE* file = fopen(dll.c_str(), "rb");
+    if (file) {
+        fseek(file, 0, SEEK_END);
+        image.resize(ftell(file));
+        fseek(file, 0, SEEK_SET);
+        image.resize(fread(image.data(), 1, image.size(), file));
+        fclose(file);
+    }
+    if (image.empty())
+        return std::string();
+
+    SHA256 hash;
+    auto whole = [&]() {
+        SHA256 digest;
+        digest.Update(image.data(), image.size());
+        return digest.Final();
+    };
+    auto read16 = [&](size_t offset) {
+        uint16_t value = 0;
+        if (offset + sizeof(value) <= image.size())
+            memcpy(&value, &image[offset], sizeof(value));
+        return value;
+    };
+    auto read32 = [&](size_t offset) {
+        uint32_t value = 0;
+        if (offset + sizeof(value) <= image.size())
+            memcpy(&value, &image[offset], sizeof(value));
+        return value;
+    };
+
+    // Only the code and data which are mapped matter, timestamp, checksum and resources are skipped
+    uint32_t pe = read32(0x3C);
+    if (read16(0) != 'ZM' || read32(pe) != 'EP')
+        return whole();
+    uint16_t number_of_sections = read16(pe + 6);
+    uint16_t size_of_optional_header = read16(pe + 20);
+    size_t optional = pe + 24;
+    uint32_t entry = read32(optional + 16);
+    uint32_t image_base = read32(optional + 28);
+    hash.Update(&entry, sizeof(entry));
+    hash.Update(&image_base, sizeof(image_base));
+
+    size_t section = optional + size_of_optional_header;
+    for (uint16_t i = 0; i < number_of_sections; ++i, section += 40) {
+        if (section + 40 > image.size())
+            return whole();
+        if (memcmp(&image[section], ".rsrc", 6) == 0)
+            continue;
+        uint32_t virtual_size = read32(section + 8);
+        uint32_t virtual_address = read32(section + 12);
+        uint32_t size_of_raw_data = read32(section + 16);
+        uint32_t pointer_to_raw_data = read32(section + 20);
+        if (size_t(pointer_to_raw_data) + size_of_raw_data > image.size())
+            return whole();
+        hash.Update(&image[section], 8);
+        hash.Update(&virtual_size, sizeof(virtual_size));
+        hash.Update(&virtual_address, sizeof(virtual_address));
+        hash.Update(&image[pointer_to_raw_data], size_of_raw_data);
+    }
+
+    return hash.Final();
+}
+
 void Close(mine* cpu)
 {
     if (cpu == nullptr)
@@ -32,10 +191,12 @@ mine* RunDLL(const std::string& dll, size_t(*parameter)(mine*, size_t(*)(mine*,
     cpu->Initialize(extend_allocator<16>::construct(allocator_size), stack_size);
     cpu->Exception = RunException;
 
+    int64_t load = Timeline::Now();
     void* image = PE::Load(dll.c_str(), [](size_t base, size_t size, void* userdata) {
         mine* cpu = (mine*)userdata;
         return cpu->Memory(base, size);
-    }, cpu, Logger<SYSTEM>);
+    }, cpu, Trace<TRACE_IMPORT>);
+    Timeline::Record("PE::Load", load, Timeline::Now());
     if (image) {
         std::string file = "./" + dll.substr(dll.find_last_of("/\\") + 1);
         std::string path = dll.substr(0, dll.find_last_of("/\\") + 1);
@@ -44,8 +205,8 @@ mine* RunDLL(const std::string& dll, size_t(*parameter)(mine*, size_t(*)(mine*,
             .path = path.c_str(),
             .printf = Logger<CONSOLE>,
             .vprintf = LoggerV<CONSOLE>,
-            .debugPrintf = debug ? Logger<SYSTEM> : nullptr,
-            .debugVprintf = debug ? LoggerV<SYSTEM> : nullptr,
+            .debugPrintf = debug ? Trace<0> : nullptr,
+            .debugVprintf = debug ? TraceV<0> : nullptr,
         };
         syscall_i386_new(cpu, &syscall);
 
@@ -56,9 +217,13 @@ mine* RunDLL(const std::string& dll, size_t(*parameter)(mine*, size_t(*)(mine*,
             .symbol = GetSymbol,
         };
         syscall_windows_new(cpu, &syscall_windows);
+        int64_t import = Timeline::Now();
         syscall_windows_import(cpu, file.c_str(), image, true);
+        Timeline::Record("Import", import, Timeline::Now());
 
+        int64_t bind = Timeline::Now();
         size_t address = parameter(cpu, GetProcAddress);
+        Timeline::Record("Entry", bind, Timeline::Now());
         if (address) {
             auto* i386 = (x86_i386*)cpu;
             auto& x86 = i386->x86;
@@ -134,7 +299,7 @@ size_t GetProcAddress(mine* cpu, void* image, const char* name)
         auto export_data = (ExportData*)userdata;
         if (strcmp(export_data->name, name) == 0) {
             export_data->address = address;
-            Logger<SYSTEM>("%-12s : [%08zX] %s", "Symbol", address, name);
+            Trace<TRACE_IMPORT>("%-12s : [%08zX] %s", "Symbol", address, name);
         }
     }, &export_data);
     return export_data.address;
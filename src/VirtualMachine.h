@@ -5,6 +5,7 @@ struct mine;
 
 namespace VirtualMachine {
 
+std::string HashImage(const std::string& dll);
 void Close(mine* cpu);
 mine* RunDLL(const std::string& dll, size_t(*parameter)(mine*, size_t(*)(mine*, void*, const char*)), bool debug);
 size_t RunException(mine* cpu, size_t index);